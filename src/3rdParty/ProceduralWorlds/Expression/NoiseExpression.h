@@ -0,0 +1,269 @@
+#pragma once
+
+#include "../Noise/NoiseMap.h"
+
+#include <array>
+#include <algorithm>
+#include <concepts>
+#include <utility>
+
+namespace that::expression
+{
+	/// <summary>
+	/// <para>A node of a noise expression</para> 
+	/// <para>A node calculates one sample from the noise values of the inputs of the expression. 
+	///	ppInputs contains a row of noise values for every input, sampleIdx is the index inside these rows</para> 
+	/// <para>inputMask has a bit for every input that the node reads</para> 
+	/// </summary>
+	template<typename T>
+	concept Node = requires(const T& node, const float* const* ppInputs, int sampleIdx)
+	{
+		{ node.Evaluate(ppInputs, sampleIdx) } -> std::same_as<float>;
+		{ T::inputMask } -> std::convertible_to<unsigned int>;
+	};
+
+	// Returns the noise value of the input at the given index
+	template<int Index>
+	struct Input final
+	{
+		static constexpr unsigned int inputMask{ 1u << Index };
+
+		constexpr float Evaluate(const float* const* ppInputs, int sampleIdx) const
+		{
+			return ppInputs[Index][sampleIdx];
+		}
+	};
+
+	struct Constant final
+	{
+		static constexpr unsigned int inputMask{};
+
+		float value{};
+
+		constexpr float Evaluate(const float* const* /*ppInputs*/, int /*sampleIdx*/) const
+		{
+			return value;
+		}
+	};
+
+	// Combines two nodes using a stateless operation
+	template<Node Left, Node Right, typename Operation>
+	struct Binary final
+	{
+		static constexpr unsigned int inputMask{ Left::inputMask | Right::inputMask };
+
+		Left left{};
+		Right right{};
+
+		constexpr float Evaluate(const float* const* ppInputs, int sampleIdx) const
+		{
+			return Operation{}(left.Evaluate(ppInputs, sampleIdx), right.Evaluate(ppInputs, sampleIdx));
+		}
+	};
+
+	// Maps a node through a stateless function (e.g. a piecewise curve)
+	template<Node Value, typename Function>
+	struct Curve final
+	{
+		static constexpr unsigned int inputMask{ Value::inputMask };
+
+		Value value{};
+		Function function{};
+
+		constexpr float Evaluate(const float* const* ppInputs, int sampleIdx) const
+		{
+			return function(value.Evaluate(ppInputs, sampleIdx));
+		}
+	};
+
+	// Returns below if the value is smaller then the threshold, otherwise returns above
+	template<Node Value, Node Below, Node Above>
+	struct Threshold final
+	{
+		static constexpr unsigned int inputMask{ Value::inputMask | Below::inputMask | Above::inputMask };
+		// Every sample reads the inputs of the value, the inputs of a side are only read by the samples that pick it
+		static constexpr unsigned int sharedInputMask{ Value::inputMask };
+
+		Value value{};
+		float threshold{};
+		Below below{};
+		Above above{};
+
+		// Returns the inputs that the sample reads, only the inputs of the value need to be available
+		constexpr unsigned int GetUsedInputs(const float* const* ppInputs, int sampleIdx) const
+		{
+			return sharedInputMask | (value.Evaluate(ppInputs, sampleIdx) < threshold ? Below::inputMask : Above::inputMask);
+		}
+
+		constexpr float Evaluate(const float* const* ppInputs, int sampleIdx) const
+		{
+			// Both sides are calculated so the selection doesn't need a branch
+			const float belowValue{ below.Evaluate(ppInputs, sampleIdx) };
+			const float aboveValue{ above.Evaluate(ppInputs, sampleIdx) };
+			return value.Evaluate(ppInputs, sampleIdx) < threshold ? belowValue : aboveValue;
+		}
+	};
+
+	struct AddOperation final { constexpr float operator()(float a, float b) const { return a + b; } };
+	struct SubtractOperation final { constexpr float operator()(float a, float b) const { return a - b; } };
+	struct MultiplyOperation final { constexpr float operator()(float a, float b) const { return a * b; } };
+	struct DivideOperation final { constexpr float operator()(float a, float b) const { return a / b; } };
+	struct MinOperation final { constexpr float operator()(float a, float b) const { return std::min(a, b); } };
+	struct MaxOperation final { constexpr float operator()(float a, float b) const { return std::max(a, b); } };
+
+	// Wraps numbers into constant nodes so they can be mixed with other nodes
+	template<Node T>
+	constexpr T ToNode(const T& node) { return node; }
+	constexpr Constant ToNode(float value) { return Constant{ value }; }
+
+	// Either side of an operator needs to be a node, the other side can be a number
+	template<typename Left, typename Right>
+	concept Operands = (Node<Left> || std::same_as<Left, float>) && (Node<Right> || std::same_as<Right, float>) && (Node<Left> || Node<Right>);
+
+	template<typename Left, typename Right, typename Operation>
+	using BinaryOf = Binary<decltype(ToNode(std::declval<Left>())), decltype(ToNode(std::declval<Right>())), Operation>;
+
+	template<typename Left, typename Right> requires Operands<Left, Right>
+	constexpr auto operator+(const Left& left, const Right& right) { return BinaryOf<Left, Right, AddOperation>{ ToNode(left), ToNode(right) }; }
+
+	template<typename Left, typename Right> requires Operands<Left, Right>
+	constexpr auto operator-(const Left& left, const Right& right) { return BinaryOf<Left, Right, SubtractOperation>{ ToNode(left), ToNode(right) }; }
+
+	template<typename Left, typename Right> requires Operands<Left, Right>
+	constexpr auto operator*(const Left& left, const Right& right) { return BinaryOf<Left, Right, MultiplyOperation>{ ToNode(left), ToNode(right) }; }
+
+	template<typename Left, typename Right> requires Operands<Left, Right>
+	constexpr auto operator/(const Left& left, const Right& right) { return BinaryOf<Left, Right, DivideOperation>{ ToNode(left), ToNode(right) }; }
+
+	template<typename Left, typename Right> requires Operands<Left, Right>
+	constexpr auto Min(const Left& left, const Right& right) { return BinaryOf<Left, Right, MinOperation>{ ToNode(left), ToNode(right) }; }
+
+	template<typename Left, typename Right> requires Operands<Left, Right>
+	constexpr auto Max(const Left& left, const Right& right) { return BinaryOf<Left, Right, MaxOperation>{ ToNode(left), ToNode(right) }; }
+
+	template<Node Value, typename Function>
+	constexpr auto MapCurve(const Value& value, const Function& function) { return Curve<Value, Function>{ value, function }; }
+
+	template<Node Value, typename Below, typename Above>
+	constexpr auto IfBelow(const Value& value, float threshold, const Below& below, const Above& above)
+	{
+		using BelowNode = decltype(ToNode(below));
+		using AboveNode = decltype(ToNode(above));
+		return Threshold<Value, BelowNode, AboveNode>{ value, threshold, ToNode(below), ToNode(above) };
+	}
+
+	// Returns the inputs that every sample of the expression reads
+	//	Only a threshold at the root of the expression leaves inputs out, a threshold inside another node reads all of its inputs
+	template<Node Expression>
+	constexpr unsigned int GetSharedInputs()
+	{
+		if constexpr (requires { Expression::sharedInputMask; }) return Expression::sharedInputMask;
+		else return Expression::inputMask;
+	}
+
+	// Returns the inputs that the sample reads, only the shared inputs of the expression need to be available
+	template<Node Expression>
+	constexpr unsigned int GetUsedInputs(const Expression& expression, const float* const* ppInputs, int sampleIdx)
+	{
+		if constexpr (requires { expression.GetUsedInputs(ppInputs, sampleIdx); }) return expression.GetUsedInputs(ppInputs, sampleIdx);
+		else return Expression::inputMask;
+	}
+
+	/// <summary>
+	/// <para>Returns the value of the expression at (x,y)</para> 
+	/// <para>Input&lt;i&gt; of the expression reads the noise of the i-th noise map</para> 
+	/// </summary>
+	template<Node Expression, size_t NrInputs>
+	float Evaluate(const Expression& expression, const std::array<const NoiseMap*, NrInputs>& pInputs, float x, float y)
+	{
+		std::array<float, NrInputs> noise{};
+		std::array<const float*, NrInputs> pNoise{};
+		for (size_t i{}; i < NrInputs; ++i)
+		{
+			pNoise[i] = &noise[i];
+		}
+
+		// Only sample the noise maps that the expression reads at this coordinate
+		constexpr unsigned int sharedInputs{ GetSharedInputs<Expression>() };
+		for (size_t i{}; i < NrInputs; ++i)
+		{
+			if (sharedInputs & (1u << i)) noise[i] = pInputs[i]->GetNoise(x, y);
+		}
+		const unsigned int usedInputs{ GetUsedInputs(expression, pNoise.data(), 0) };
+		for (size_t i{}; i < NrInputs; ++i)
+		{
+			if ((usedInputs & ~sharedInputs) & (1u << i)) noise[i] = pInputs[i]->GetNoise(x, y);
+		}
+
+		return expression.Evaluate(pNoise.data(), 0);
+	}
+
+	/// <summary>
+	/// <para>Calculates the value of the expression for count coordinates starting at (x,y), each step units further along the x-axis</para> 
+	/// <para>Every noise map is evaluated once per row, after which the whole expression is calculated in one loop</para> 
+	/// <para>Noise maps that only some samples read are only evaluated over the runs of samples that read them</para> 
+	/// </summary>
+	template<Node Expression, size_t NrInputs>
+	void EvaluateRow(const Expression& expression, const std::array<const NoiseMap*, NrInputs>& pInputs, float x, float y, float step, int count, float* pValues)
+	{
+		// The row is split up in batches so the noise of each input fits on the stack
+		constexpr int batchSize{ 256 };
+		std::array<std::array<float, batchSize>, NrInputs> noise;
+		std::array<const float*, NrInputs> pNoise{};
+		for (size_t i{}; i < NrInputs; ++i)
+		{
+			pNoise[i] = noise[i].data();
+		}
+
+		for (int batchStart{}; batchStart < count; batchStart += batchSize)
+		{
+			const int batchCount{ std::min(batchSize, count - batchStart) };
+			const float batchX{ x + static_cast<float>(batchStart) * step };
+
+			constexpr unsigned int sharedInputs{ GetSharedInputs<Expression>() };
+			for (size_t i{}; i < NrInputs; ++i)
+			{
+				if (sharedInputs & (1u << i)) pInputs[i]->GetNoiseRow(batchX, y, step, batchCount, noise[i].data());
+			}
+
+			constexpr unsigned int conditionalInputs{ Expression::inputMask & ~sharedInputs };
+			if constexpr (conditionalInputs != 0)
+			{
+				std::array<unsigned int, batchSize> usedInputs;
+				for (int sampleIdx{}; sampleIdx < batchCount; ++sampleIdx)
+				{
+					usedInputs[sampleIdx] = GetUsedInputs(expression, pNoise.data(), sampleIdx);
+				}
+
+				for (size_t i{}; i < NrInputs; ++i)
+				{
+					const unsigned int inputBit{ 1u << i };
+					if (!(conditionalInputs & inputBit)) continue;
+
+					// The samples outside the runs never use the noise, they are only cleared so the expression reads a defined value
+					std::fill_n(noise[i].data(), batchCount, 0.0f);
+					for (int runStart{}; runStart < batchCount;)
+					{
+						if (!(usedInputs[runStart] & inputBit))
+						{
+							++runStart;
+							continue;
+						}
+
+						int runEnd{ runStart + 1 };
+						while (runEnd < batchCount && (usedInputs[runEnd] & inputBit)) ++runEnd;
+
+						pInputs[i]->GetNoiseRow(batchX + static_cast<float>(runStart) * step, y, step, runEnd - runStart, noise[i].data() + runStart);
+						runStart = runEnd;
+					}
+				}
+			}
+
+			float* pBatchValues{ pValues + batchStart };
+			for (int sampleIdx{}; sampleIdx < batchCount; ++sampleIdx)
+			{
+				pBatchValues[sampleIdx] = expression.Evaluate(pNoise.data(), sampleIdx);
+			}
+		}
+	}
+}
@@ -2,6 +2,12 @@
 
 #include "WorldShape/WorldShape.h"
 
+#include <execution>
+#include <algorithm>
+#include <numeric>
+
+const int that::Generator::m_MinParallelRegionSize{ 128 * 128 };
+
 void that::Generator::SetSize(float size)
 {
 	m_Size = size;
@@ -33,51 +39,76 @@ float that::Generator::GetHeight(float x, float y) const
 	return height;
 }
 
-bool that::Generator::TryPredicates(int step)
+void that::Generator::GetHeightRow(float x, float y, float step, std::span<float> heights) const
 {
-	if (m_SuccessPredicates.empty()) return true;
+	// Retrieve the heights from the heightmap
+	m_HeightMap.GetHeightRow(x, y, step, heights);
 
-	std::vector<SuccessPredicate> predicatesCopy{ m_SuccessPredicates };
-
-	for (int x{}; x < m_Size; x += step)
-	{
-		float prevHeight{ GetHeight(static_cast<float>(x), 0.0f)};
+	// If a shape is assigned, transform the whole row at once to match the shape
+	if (m_pShape) m_pShape->TransformBlock(m_Size, x, y, step, heights);
+}
 
-		for (int z{ 1 }; z < m_Size; z += step)
+void that::Generator::FillRegion(float x0, float y0, int width, int height, float step, float* pHeights, int stride) const
+{
+	const auto fillRow{ [&](int row)
 		{
-			float height{ GetHeight(static_cast<float>(x), static_cast<float>(z)) };
-
-			for (int i{ static_cast<int>(predicatesCopy.size()) - 1 }; i >= 0; --i)
-			{
-				const auto& predicate{ predicatesCopy[i] };
-
-				if (predicate.IsTrue(height, prevHeight)) predicatesCopy.erase(begin(predicatesCopy) + i);
-			}
+			GetHeightRow(x0, y0 + static_cast<float>(row) * step, step, std::span<float>{ pHeights + row * stride, static_cast<size_t>(width) });
+		} };
 
-			prevHeight = height;
+	// Small regions aren't worth the overhead of starting multiple threads
+	if (width * height < m_MinParallelRegionSize)
+	{
+		for (int row{}; row < height; ++row)
+		{
+			fillRow(row);
 		}
+		return;
 	}
 
-	if (predicatesCopy.empty()) return true;
+	std::vector<int> rows(height);
+	std::iota(begin(rows), end(rows), 0);
+	std::for_each(std::execution::par, begin(rows), end(rows), fillRow);
+}
 
-	for (int z{}; z < m_Size; z += step)
+bool that::Generator::TryPredicates(int step) const
+{
+	if (m_SuccessPredicates.empty()) return true;
+
+	// Keep track of the predicates that haven't been true yet
+	std::vector<const SuccessPredicate*> remainingPredicates{};
+	remainingPredicates.reserve(m_SuccessPredicates.size());
+	for (const SuccessPredicate& predicate : m_SuccessPredicates)
 	{
-		float prevHeight{ GetHeight(0.0f, static_cast<float>(z)) };
+		remainingPredicates.push_back(&predicate);
+	}
 
-		for (int x{ 1 }; x < m_Size; x += step)
+	// Removes every predicate that is true for this pair of heights and returns if all predicates have been true
+	const auto checkPredicates{ [&remainingPredicates](float height, float prevHeight)
 		{
-			float height{ GetHeight(static_cast<float>(x), static_cast<float>(z)) };
+			std::erase_if(remainingPredicates, [=](const SuccessPredicate* pPredicate) { return pPredicate->IsTrue(height, prevHeight); });
+			return remainingPredicates.empty();
+		} };
 
-			for (int i{ static_cast<int>(predicatesCopy.size()) - 1 }; i >= 0; --i)
-			{
-				const auto& predicate{ predicatesCopy[i] };
+	// Calculate the amount of samples in a row of the grid
+	int nrSamples{};
+	for (int x{}; x < m_Size; x += step) ++nrSamples;
 
-				if (predicate.IsTrue(height, prevHeight)) predicatesCopy.erase(begin(predicatesCopy) + i);
-			}
+	// Walk over the grid once, comparing each height with its neighbour on the left and its neighbour in the previous row
+	std::vector<float> prevRow(nrSamples);
+	std::vector<float> row(nrSamples);
 
-			prevHeight = height;
+	for (int z{}; z < m_Size; z += step)
+	{
+		GetHeightRow(0.0f, static_cast<float>(z), static_cast<float>(step), row);
+
+		for (int x{}; x < nrSamples; ++x)
+		{
+			if (x > 0 && checkPredicates(row[x], row[x - 1])) return true;
+			if (z > 0 && checkPredicates(row[x], prevRow[x])) return true;
 		}
+
+		std::swap(row, prevRow);
 	}
 
-	return predicatesCopy.empty();
+	return false;
 }
\ No newline at end of file
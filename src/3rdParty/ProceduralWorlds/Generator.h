@@ -5,6 +5,7 @@
 #include "WorldShape/WorldShape.h"
 
 #include <memory>
+#include <span>
 
 namespace that
 {
@@ -22,7 +23,21 @@ namespace that
 
 		// Returns the heightmap value [0,1] for this coordinate
 		float GetHeight(float x, float y) const;
-		bool TryPredicates(int step);
+
+		// Fills the heights of a row starting at (x,y), each height step units further along the x-axis
+		void GetHeightRow(float x, float y, float step, std::span<float> heights) const;
+
+		/// <summary>
+		/// <para>Fills a region of width by height samples starting at (x0,y0), neighbouring samples are step units apart</para> 
+		/// <para>Row r of the region is written to pHeights + r * stride, large regions are filled in parallel</para> 
+		/// </summary>
+		void FillRegion(float x0, float y0, int width, int height, float step, float* pHeights, int stride) const;
+
+		/// <summary>
+		/// <para>Returns true if every predicate is true for at least one pair of neighbouring heights</para> 
+		/// <para>The heights are sampled on a grid with the given step, the search stops as soon as every predicate has been true</para> 
+		/// </summary>
+		bool TryPredicates(int step) const;
 
 	private:
 		HeightMap m_HeightMap{};
@@ -32,5 +47,7 @@ namespace that
 		std::unique_ptr<shape::WorldShape> m_pShape{};
 
 		float m_Size{ 100.0f };
+
+		static const int m_MinParallelRegionSize;
 	};
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "HeightMap.h"
 
+#include <algorithm>
+#include <array>
+
 void that::HeightMap::AddNoiseMap(const NoiseMap& noiseMap)
 {
 	m_NoiseMaps.push_back(noiseMap);
@@ -39,5 +42,97 @@ float that::HeightMap::GetHeight(float x, float y) const
 		height /= static_cast<int>(m_NoiseMaps.size());
 	}
 
+	return height;
+}
+
+void that::HeightMap::GetHeightRow(float x, float y, float step, std::span<float> heights) const
+{
+	// The row is split up in batches so the noise of a batch fits on the stack
+	constexpr int batchSize{ 256 };
+	std::array<float, batchSize> noise;
+
+	const int count{ static_cast<int>(heights.size()) };
+	for (int batchStart{}; batchStart < count; batchStart += batchSize)
+	{
+		const int batchCount{ std::min(batchSize, count - batchStart) };
+		const float batchX{ x + static_cast<float>(batchStart) * step };
+		float* pBatchHeights{ heights.data() + batchStart };
+
+		// The default height should be 1 if the blendmode is set to Multiply, 
+		//	otherwise all multiplications will be ignored
+		std::fill(pBatchHeights, pBatchHeights + batchCount, m_BlendMode == BlendMode::Multiply ? 1.0f : 0.0f);
+
+		// Calculate the noise of each noise map for the whole batch and blend it with the appropriate blend mode
+		for (const NoiseMap& noiseMap : m_NoiseMaps)
+		{
+			noiseMap.GetNoiseRow(batchX, y, step, batchCount, noise.data());
+
+			switch (m_BlendMode)
+			{
+			case BlendMode::Multiply:
+				for (int i{}; i < batchCount; ++i)
+				{
+					pBatchHeights[i] *= noise[i];
+				}
+				break;
+			case BlendMode::Add:
+			case BlendMode::Average:
+				for (int i{}; i < batchCount; ++i)
+				{
+					pBatchHeights[i] += noise[i];
+				}
+				break;
+			}
+		}
+
+		// Calculate the average if all the noise maps if the BlendMode is set to Average
+		if (m_BlendMode == BlendMode::Average)
+		{
+			const float nrNoiseMaps{ static_cast<float>(m_NoiseMaps.size()) };
+			for (int i{}; i < batchCount; ++i)
+			{
+				pBatchHeights[i] /= nrNoiseMaps;
+			}
+		}
+	}
+}
+
+that::NoiseSample that::HeightMap::GetHeightWithDerivatives(float x, float y) const
+{
+	// The default height should be 1 if the blendmode is set to Multiply, 
+	//	otherwise all multiplications will be ignored
+	NoiseSample height{ m_BlendMode == BlendMode::Multiply ? 1.0f : 0.0f };
+
+	// Generate the height and derivatives for this coordinate using the appropriate blend mode
+	for (const NoiseMap& noiseMap : m_NoiseMaps)
+	{
+		const NoiseSample noise{ noiseMap.GetNoiseWithDerivatives(x, y) };
+
+		switch (m_BlendMode)
+		{
+		case BlendMode::Multiply:
+			// Apply the product rule to the derivatives
+			height.dx = height.dx * noise.value + height.value * noise.dx;
+			height.dy = height.dy * noise.value + height.value * noise.dy;
+			height.value *= noise.value;
+			break;
+		case BlendMode::Add:
+		case BlendMode::Average:
+			height.value += noise.value;
+			height.dx += noise.dx;
+			height.dy += noise.dy;
+			break;
+		}
+	}
+
+	// Calculate the average if all the noise maps if the BlendMode is set to Average
+	if (m_BlendMode == BlendMode::Average)
+	{
+		const float nrNoiseMaps{ static_cast<float>(m_NoiseMaps.size()) };
+		height.value /= nrNoiseMaps;
+		height.dx /= nrNoiseMaps;
+		height.dy /= nrNoiseMaps;
+	}
+
 	return height;
 }
\ No newline at end of file
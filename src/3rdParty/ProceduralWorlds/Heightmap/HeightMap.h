@@ -3,6 +3,7 @@
 #include "../Noise/NoiseMap.h"
 
 #include <vector>
+#include <span>
 
 namespace that
 {
@@ -24,6 +25,15 @@ namespace that
 
 		float GetHeight(float x, float y) const;
 
+		/// <summary>
+		/// <para>Fills the heights of a row starting at (x,y), each height step units further along the x-axis</para> 
+		/// <para>Every noise map is calculated for a batch of the row on the stack first, afterwards the batches are blended in one loop per blend mode</para> 
+		/// </summary>
+		void GetHeightRow(float x, float y, float step, std::span<float> heights) const;
+
+		// Returns the height at (x,y) together with its derivatives along the x- and y-axis
+		NoiseSample GetHeightWithDerivatives(float x, float y) const;
+
 	private:
 		std::vector<NoiseMap> m_NoiseMaps{};
 
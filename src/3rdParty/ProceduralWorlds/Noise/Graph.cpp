@@ -1,6 +1,7 @@
 #include "Graph.h"
 
 #include <stdexcept>
+#include <algorithm>
 
 void that::Graph::AddNode(float x, float y)
 {
@@ -34,4 +35,83 @@ float that::Graph::GetValue(float x) const
 	const float percentage{ (x - smallerNode->first) / (greaterNode->first - smallerNode->first) };
 	const float value{ smallerNode->second + (greaterNode->second - smallerNode->second) * percentage };
 	return value;
+}
+
+void that::Graph::GetValues(float* pValues, int count) const
+{
+	// Check the graph bounds once for all the values
+	if (m_Nodes.find(0.0f) == end(m_Nodes)) throw std::runtime_error("No lower bound node (x = 0) is added.");
+	if (m_Nodes.find(1.0f) == end(m_Nodes)) throw std::runtime_error("No upper bound node (x = 1) is added.");
+
+	for (int i{}; i < count; ++i)
+	{
+		const float x{ pValues[i] };
+
+		// Check bound limits
+		if (x < 0.0f) throw std::runtime_error("No value should be mapped under 0");
+		if (x > 1.0f) throw std::runtime_error("No value should be mapped above 1");
+
+		// Retrieve the first node greater (or equal) then the given value
+		const auto greaterNode{ m_Nodes.lower_bound(x) };
+
+		// If the given value is 0, we only need the first node
+		if (x < FLT_EPSILON)
+		{
+			pValues[i] = greaterNode->second;
+			continue;
+		}
+
+		// Retrieve the first node smaller then the given value
+		const auto smallerNode{ std::prev(greaterNode) };
+
+		// Lerp between the two values
+		const float percentage{ (x - smallerNode->first) / (greaterNode->first - smallerNode->first) };
+		pValues[i] = smallerNode->second + (greaterNode->second - smallerNode->second) * percentage;
+	}
+}
+
+that::NoiseSample that::Graph::GetValue(const NoiseSample& sample) const
+{
+	const float x{ sample.value };
+
+	// Check bound limits
+	if (x < 0.0f) throw std::runtime_error("No value should be mapped under 0");
+	if (x > 1.0f) throw std::runtime_error("No value should be mapped above 1");
+	if (m_Nodes.find(0.0f) == end(m_Nodes)) throw std::runtime_error("No lower bound node (x = 0) is added.");
+	if (m_Nodes.find(1.0f) == end(m_Nodes)) throw std::runtime_error("No upper bound node (x = 1) is added.");
+
+	// Retrieve the segment that contains the given value, a value of 0 uses the first segment
+	auto greaterNode{ m_Nodes.lower_bound(x) };
+	if (greaterNode == begin(m_Nodes)) ++greaterNode;
+	const auto smallerNode{ std::prev(greaterNode) };
+
+	// The graph is linear inside a segment, so the slope of the segment is the derivative of the graph
+	const float slope{ (greaterNode->second - smallerNode->second) / (greaterNode->first - smallerNode->first) };
+
+	return NoiseSample
+	{
+		GetValue(x),
+		sample.dx * slope,
+		sample.dy * slope
+	};
+}
+
+that::RangeFloat that::Graph::GetValueBounds(float minX, float maxX) const
+{
+	// Keep the range inside the bounds of the graph
+	minX = std::clamp(minX, 0.0f, 1.0f);
+	maxX = std::clamp(maxX, 0.0f, 1.0f);
+
+	// The graph is linear between nodes, so the extremes are found at the range limits or at a node inside the range
+	const float minValue{ GetValue(minX) };
+	const float maxValue{ GetValue(maxX) };
+	RangeFloat bounds{ std::min(minValue, maxValue), std::max(minValue, maxValue) };
+
+	for (auto it{ m_Nodes.upper_bound(minX) }; it != end(m_Nodes) && it->first < maxX; ++it)
+	{
+		bounds.lower = std::min(bounds.lower, it->second);
+		bounds.upper = std::max(bounds.upper, it->second);
+	}
+
+	return bounds;
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "../Structs/ThatRange.h"
+#include "../Structs/ThatNoiseSample.h"
+
 #include <map>
 
 namespace that
@@ -23,6 +26,24 @@ namespace that
 		/// </summary>
 		float GetValue(float x) const;
 
+		/// <summary>
+		/// <para>Replaces each of the count x values with its y-value on the graph</para> 
+		/// <para>The same rules as GetValue apply to every x value</para> 
+		/// </summary>
+		void GetValues(float* pValues, int count) const;
+
+		/// <summary>
+		/// <para>Returns the y-value on the graph for the value of the sample</para> 
+		/// <para>The derivatives of the sample are multiplied with the slope of the graph segment that contains the value</para> 
+		/// </summary>
+		NoiseSample GetValue(const NoiseSample& sample) const;
+
+		/// <summary>
+		/// <para>Returns the range of y-values [0,1] on the graph for all x values between minX and maxX</para> 
+		/// <para>The given x values are clamped between [0,1]</para> 
+		/// </summary>
+		RangeFloat GetValueBounds(float minX, float maxX) const;
+
 	private:
 		std::map<float, float> m_Nodes{};
 	};
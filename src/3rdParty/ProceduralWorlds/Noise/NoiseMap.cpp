@@ -5,6 +5,23 @@ float that::NoiseMap::GetNoise(float x, float y) const
 	return m_Graph.GetValue(m_Perlin.GetNoise(x, y));
 }
 
+that::NoiseSample that::NoiseMap::GetNoiseWithDerivatives(float x, float y) const
+{
+	return m_Graph.GetValue(m_Perlin.GetNoiseWithDerivatives(x, y));
+}
+
+void that::NoiseMap::GetNoiseRow(float x, float y, float step, int count, float* pNoise) const
+{
+	m_Perlin.GetNoiseRow(x, y, step, count, pNoise);
+	m_Graph.GetValues(pNoise, count);
+}
+
+that::RangeFloat that::NoiseMap::GetNoiseBounds(float minX, float minY, float maxX, float maxY) const
+{
+	const RangeFloat perlinBounds{ m_Perlin.GetNoiseBounds(minX, minY, maxX, maxY) };
+	return m_Graph.GetValueBounds(perlinBounds.lower, perlinBounds.upper);
+}
+
 that::PerlinComposition& that::NoiseMap::GetPerlin()
 {
 	return m_Perlin;
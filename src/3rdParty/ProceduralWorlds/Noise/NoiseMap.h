@@ -13,6 +13,15 @@ namespace that
 
 		float GetNoise(float x, float y) const;
 
+		// Returns the noise at (x,y) together with its derivatives along the x- and y-axis
+		NoiseSample GetNoiseWithDerivatives(float x, float y) const;
+
+		// Calculates the noise of count coordinates starting at (x,y), each step units further along the x-axis
+		void GetNoiseRow(float x, float y, float step, int count, float* pNoise) const;
+
+		// Returns a conservative range [0,1] that contains every noise value inside the given rectangle
+		RangeFloat GetNoiseBounds(float minX, float minY, float maxX, float maxY) const;
+
 		PerlinComposition& GetPerlin();
 		Graph& GetGraph();
 
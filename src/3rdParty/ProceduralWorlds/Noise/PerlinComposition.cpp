@@ -1,7 +1,12 @@
 #include "PerlinComposition.h"
 
+#include <algorithm>
+#include <climits>
+
 const float that::PerlinComposition::m_MiddleOfNoise{ 500'000 };
 const float that::PerlinComposition::m_MaxOctaveDisplacement{ 100'000 };
+const int that::PerlinComposition::m_MaxBoundsCells{ 16 };
+const float that::PerlinComposition::m_BoundsEpsilon{ 0.0001f };
 
 void that::PerlinComposition::AddOctave(float multiplier, float zoom)
 {
@@ -42,6 +47,60 @@ float that::PerlinComposition::GetNoise(float x, float y) const
 	return noise;
 }
 
+that::NoiseSample that::PerlinComposition::GetNoiseWithDerivatives(float x, float y) const
+{
+	// Calculate the noise and its derivatives at this point
+	NoiseSample sample{};
+	for (const auto& octave : m_Octaves)
+	{
+		const NoiseSample octaveSample{ GetOctaveNoiseWithDerivatives(x, y, octave) };
+		sample.value += octaveSample.value;
+		sample.dx += octaveSample.dx;
+		sample.dy += octaveSample.dy;
+	}
+
+	// map -maxNoise -> maxNoise to 0 -> 1, the derivatives only get scaled
+	sample.value = (sample.value + m_MaxNoiseValue) / (2.0f * m_MaxNoiseValue);
+	sample.dx /= 2.0f * m_MaxNoiseValue;
+	sample.dy /= 2.0f * m_MaxNoiseValue;
+
+	return sample;
+}
+
+void that::PerlinComposition::GetNoiseRow(float x, float y, float step, int count, float* pNoise) const
+{
+	// Calculate the noise of the whole row, one octave at a time
+	std::fill(pNoise, pNoise + count, 0.0f);
+	for (const auto& octave : m_Octaves)
+	{
+		AddOctaveNoiseRow(x, y, step, count, pNoise, octave);
+	}
+
+	// map -maxNoise -> maxNoise to 0 -> 1
+	for (int i{}; i < count; ++i)
+	{
+		pNoise[i] = (pNoise[i] + m_MaxNoiseValue) / (2.0f * m_MaxNoiseValue);
+	}
+}
+
+that::RangeFloat that::PerlinComposition::GetNoiseBounds(float minX, float minY, float maxX, float maxY) const
+{
+	// Sum the ranges of all the octaves
+	RangeFloat bounds{};
+	for (const auto& octave : m_Octaves)
+	{
+		const RangeFloat octaveBounds{ GetOctaveBounds(minX, minY, maxX, maxY, octave) };
+		bounds.lower += octaveBounds.lower;
+		bounds.upper += octaveBounds.upper;
+	}
+
+	// map -maxNoise -> maxNoise to 0 -> 1
+	bounds.lower = (bounds.lower + m_MaxNoiseValue) / (2.0f * m_MaxNoiseValue);
+	bounds.upper = (bounds.upper + m_MaxNoiseValue) / (2.0f * m_MaxNoiseValue);
+
+	return bounds;
+}
+
 float that::PerlinComposition::GetOctaveNoise(float x, float y, const PerlinOctave& octave) const
 {	
 	// Displace the current coordinate depending on the octave
@@ -77,6 +136,194 @@ float that::PerlinComposition::GetOctaveNoise(float x, float y, const PerlinOcta
 	return result * octave.multiplier;
 }
 
+that::NoiseSample that::PerlinComposition::GetOctaveNoiseWithDerivatives(float x, float y, const PerlinOctave& octave) const
+{
+	// Displace and zoom the coordinate the same way as GetOctaveNoise
+	const float latticeX{ (x + (m_MiddleOfNoise + octave.offset.x)) * octave.zoom };
+	const float latticeY{ (y + (m_MiddleOfNoise + octave.offset.y)) * octave.zoom };
+
+	// Calculate the grid corners
+	const int gridX0{ static_cast<int>(latticeX) };
+	const int gridX1{ gridX0 + 1 };
+	const int gridY0{ static_cast<int>(latticeY) };
+	const int gridY1{ gridY0 + 1 };
+
+	// Calculate the position in the current grid cell
+	const float gridPosX{ latticeX - static_cast<float>(gridX0) };
+	const float gridPosY{ latticeY - static_cast<float>(gridY0) };
+
+	// Calculate the gradients for each grid corner
+	const Vector2Float gradient0{ GetRandomGradient(gridX0, gridY0) };
+	const Vector2Float gradient1{ GetRandomGradient(gridX1, gridY0) };
+	const Vector2Float gradient2{ GetRandomGradient(gridX0, gridY1) };
+	const Vector2Float gradient3{ GetRandomGradient(gridX1, gridY1) };
+
+	const float dotGradient0{ Dot(gradient0, Vector2Float{ gridPosX, gridPosY }) };
+	const float dotGradient1{ Dot(gradient1, Vector2Float{ gridPosX - 1.0f, gridPosY }) };
+	const float dotGradient2{ Dot(gradient2, Vector2Float{ gridPosX, gridPosY - 1.0f }) };
+	const float dotGradient3{ Dot(gradient3, Vector2Float{ gridPosX - 1.0f, gridPosY - 1.0f }) };
+
+	// The smoothing formula 3x^2 - 2x^3 has the derivative 6x - 6x^2
+	const float xEase{ 3.0f * powf(gridPosX, 2.0f) - 2.0f * powf(gridPosX, 3.0f) };
+	const float yEase{ 3.0f * powf(gridPosY, 2.0f) - 2.0f * powf(gridPosY, 3.0f) };
+	const float xEaseSlope{ 6.0f * gridPosX * (1.0f - gridPosX) };
+	const float yEaseSlope{ 6.0f * gridPosY * (1.0f - gridPosY) };
+
+	const float bottom{ Lerp(dotGradient0, dotGradient1, xEase) };
+	const float top{ Lerp(dotGradient2, dotGradient3, xEase) };
+
+	// Differentiate the interpolation: the dot products change with the gradients, the weights change with the ease slopes
+	const float gradientX{ Lerp(Lerp(gradient0.x, gradient1.x, xEase), Lerp(gradient2.x, gradient3.x, xEase), yEase) };
+	const float gradientY{ Lerp(Lerp(gradient0.y, gradient1.y, xEase), Lerp(gradient2.y, gradient3.y, xEase), yEase) };
+	const float dx{ gradientX + xEaseSlope * Lerp(dotGradient1 - dotGradient0, dotGradient3 - dotGradient2, yEase) };
+	const float dy{ gradientY + yEaseSlope * (top - bottom) };
+
+	// The zoom of the octave scales the derivatives of the coordinate
+	return NoiseSample
+	{
+		Lerp(bottom, top, yEase) * octave.multiplier,
+		dx * octave.zoom * octave.multiplier,
+		dy * octave.zoom * octave.multiplier
+	};
+}
+
+void that::PerlinComposition::AddOctaveNoiseRow(float x, float y, float step, int count, float* pNoise, const PerlinOctave& octave) const
+{
+	// The whole row shares the same y coordinate, so the vertical position inside the grid cell is the same for every coordinate
+	const float latticeY{ (y + (m_MiddleOfNoise + octave.offset.y)) * octave.zoom };
+	const int gridY0{ static_cast<int>(latticeY) };
+	const int gridY1{ gridY0 + 1 };
+	const float gridPosY{ latticeY - static_cast<float>(gridY0) };
+	const float yEase{ 3.0f * powf(gridPosY, 2.0f) - 2.0f * powf(gridPosY, 3.0f) };
+
+	// Inside a grid cell the noise can be written as a + b * x + xEase * (c + d * x)
+	//	These coefficients only change when the row enters a new grid cell
+	int cachedGridX0{ INT_MIN };
+	float constant{};
+	float slope{};
+	float easeConstant{};
+	float easeSlope{};
+
+	for (int i{}; i < count; ++i)
+	{
+		// Displace and zoom the coordinate the same way as GetOctaveNoise
+		const float latticeX{ (x + static_cast<float>(i) * step + (m_MiddleOfNoise + octave.offset.x)) * octave.zoom };
+		const int gridX0{ static_cast<int>(latticeX) };
+
+		if (gridX0 != cachedGridX0)
+		{
+			cachedGridX0 = gridX0;
+			const int gridX1{ gridX0 + 1 };
+
+			// Calculate the gradients for each grid corner
+			const Vector2Float gradient0{ GetRandomGradient(gridX0, gridY0) };
+			const Vector2Float gradient1{ GetRandomGradient(gridX1, gridY0) };
+			const Vector2Float gradient2{ GetRandomGradient(gridX0, gridY1) };
+			const Vector2Float gradient3{ GetRandomGradient(gridX1, gridY1) };
+
+			// Interpolate the gradients vertically, this gives the left (x = 0) and right (x = 1) side of the cell
+			const float leftSlope{ Lerp(gradient0.x, gradient2.x, yEase) };
+			const float leftConstant{ Lerp(gradient0.y * gridPosY, gradient2.y * (gridPosY - 1.0f), yEase) };
+			const float rightSlope{ Lerp(gradient1.x, gradient3.x, yEase) };
+			const float rightConstant{ Lerp(gradient1.y * gridPosY, gradient3.y * (gridPosY - 1.0f), yEase) - rightSlope };
+
+			// Apply the multiplier of the octave to the coefficients
+			constant = leftConstant * octave.multiplier;
+			slope = leftSlope * octave.multiplier;
+			easeConstant = (rightConstant - leftConstant) * octave.multiplier;
+			easeSlope = (rightSlope - leftSlope) * octave.multiplier;
+		}
+
+		// Calculate the position in the current grid cell
+		const float gridPosX{ latticeX - static_cast<float>(gridX0) };
+		const float xEase{ gridPosX * gridPosX * (3.0f - 2.0f * gridPosX) };
+
+		pNoise[i] += constant + slope * gridPosX + xEase * (easeConstant + easeSlope * gridPosX);
+	}
+}
+
+that::RangeFloat that::PerlinComposition::GetOctaveBounds(float minX, float minY, float maxX, float maxY, const PerlinOctave& octave) const
+{
+	// A single octave never exceeds its multiplier
+	const float multiplier{ fabsf(octave.multiplier) };
+	const RangeFloat octaveRange{ -multiplier, multiplier };
+
+	// Displace and zoom the rectangle exactly like a single coordinate, 
+	//	so every coordinate inside the rectangle stays inside the displaced rectangle
+	const float latticeMinX{ (minX + (m_MiddleOfNoise + octave.offset.x)) * octave.zoom };
+	const float latticeMaxX{ (maxX + (m_MiddleOfNoise + octave.offset.x)) * octave.zoom };
+	const float latticeMinY{ (minY + (m_MiddleOfNoise + octave.offset.y)) * octave.zoom };
+	const float latticeMaxY{ (maxY + (m_MiddleOfNoise + octave.offset.y)) * octave.zoom };
+
+	// Calculate the grid cells that the rectangle overlaps
+	const int gridMinX{ static_cast<int>(latticeMinX) };
+	const int gridMaxX{ static_cast<int>(latticeMaxX) };
+	const int gridMinY{ static_cast<int>(latticeMinY) };
+	const int gridMaxY{ static_cast<int>(latticeMaxY) };
+
+	// If the rectangle overlaps too many grid cells, checking every cell isn't worth it
+	if ((gridMaxX - gridMinX + 1) * (gridMaxY - gridMinY + 1) > m_MaxBoundsCells) return octaveRange;
+
+	float lower{ FLT_MAX };
+	float upper{ -FLT_MAX };
+
+	for (int gridX{ gridMinX }; gridX <= gridMaxX; ++gridX)
+	{
+		// Calculate the part of the rectangle that lies inside this grid cell
+		const float cellMinX{ std::max(latticeMinX - static_cast<float>(gridX), 0.0f) };
+		const float cellMaxX{ std::min(latticeMaxX - static_cast<float>(gridX), 1.0f) };
+
+		for (int gridY{ gridMinY }; gridY <= gridMaxY; ++gridY)
+		{
+			const float cellMinY{ std::max(latticeMinY - static_cast<float>(gridY), 0.0f) };
+			const float cellMaxY{ std::min(latticeMaxY - static_cast<float>(gridY), 1.0f) };
+
+			// Calculate the range of the dot product of each grid corner inside the cell
+			RangeFloat dotGradients[4]{};
+			for (int corner{}; corner < 4; ++corner)
+			{
+				const int cornerX{ corner % 2 };
+				const int cornerY{ corner / 2 };
+
+				const Vector2Float gradient{ GetRandomGradient(gridX + cornerX, gridY + cornerY) };
+
+				const float dotMinX{ gradient.x * (cellMinX - static_cast<float>(cornerX)) };
+				const float dotMaxX{ gradient.x * (cellMaxX - static_cast<float>(cornerX)) };
+				const float dotMinY{ gradient.y * (cellMinY - static_cast<float>(cornerY)) };
+				const float dotMaxY{ gradient.y * (cellMaxY - static_cast<float>(cornerY)) };
+
+				dotGradients[corner] = RangeFloat
+				{
+					std::min(dotMinX, dotMaxX) + std::min(dotMinY, dotMaxY),
+					std::max(dotMinX, dotMaxX) + std::max(dotMinY, dotMaxY)
+				};
+			}
+
+			// The smoothing formula 3x^2 - 2x^3 is increasing between [0,1], so the limits of the cell give the limits of the ease
+			const RangeFloat xEase{ 3.0f * powf(cellMinX, 2.0f) - 2.0f * powf(cellMinX, 3.0f), 3.0f * powf(cellMaxX, 2.0f) - 2.0f * powf(cellMaxX, 3.0f) };
+			const RangeFloat yEase{ 3.0f * powf(cellMinY, 2.0f) - 2.0f * powf(cellMinY, 3.0f), 3.0f * powf(cellMaxY, 2.0f) - 2.0f * powf(cellMaxY, 3.0f) };
+
+			// Interpolate the ranges the same way as the noise itself
+			const RangeFloat result{ LerpRange(LerpRange(dotGradients[0], dotGradients[1], xEase), LerpRange(dotGradients[2], dotGradients[3], xEase), yEase) };
+
+			lower = std::min(lower, result.lower);
+			upper = std::max(upper, result.upper);
+		}
+	}
+
+	// Apply the multiplier of the octave, a negative multiplier flips the range
+	const float scaledLower{ lower * octave.multiplier };
+	const float scaledUpper{ upper * octave.multiplier };
+
+	// Widen the range slightly to cover floating point differences with the per coordinate noise
+	const float epsilon{ m_BoundsEpsilon * multiplier };
+	return RangeFloat
+	{
+		std::max(std::min(scaledLower, scaledUpper) - epsilon, octaveRange.lower),
+		std::min(std::max(scaledLower, scaledUpper) + epsilon, octaveRange.upper)
+	};
+}
+
 that::Vector2Float that::PerlinComposition::GetRandomGradient(int ix, int iy) const
 {
 	// No precomputed gradients mean this works for any number of grid coordinates
@@ -103,6 +350,20 @@ float that::PerlinComposition::Lerp(float a, float b, float t) const
 	return a + t * (b - a);
 }
 
+that::RangeFloat that::PerlinComposition::LerpRange(const RangeFloat& a, const RangeFloat& b, const RangeFloat& t) const
+{
+	// Lerp written as a weighted sum, both weights are positive so only the limits of the weights need to be checked
+	const float products[4]
+	{
+		(1.0f - t.lower) * a.lower + t.lower * b.lower,
+		(1.0f - t.upper) * a.lower + t.upper * b.lower,
+		(1.0f - t.lower) * a.upper + t.lower * b.upper,
+		(1.0f - t.upper) * a.upper + t.upper * b.upper
+	};
+
+	return RangeFloat{ *std::min_element(products, products + 4), *std::max_element(products, products + 4) };
+}
+
 float that::PerlinComposition::Dot(const Vector2Float& a, const Vector2Float& b) const
 {
 	return a.x * b.x + a.y * b.y;
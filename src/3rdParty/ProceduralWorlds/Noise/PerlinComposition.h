@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../Structs/ThatVector2.h"
+#include "../Structs/ThatRange.h"
+#include "../Structs/ThatNoiseSample.h"
 
 #include <vector>
 
@@ -17,6 +19,24 @@ namespace that
 		float GetNoise(int x, int y) const;
 		float GetNoise(float x, float y) const;
 
+		/// <summary>
+		/// <para>Returns the noise [0,1] at (x,y) together with its derivatives along the x- and y-axis</para> 
+		/// <para>The derivatives are calculated analytically from the same gradients as the noise, no extra samples are needed</para> 
+		/// </summary>
+		NoiseSample GetNoiseWithDerivatives(float x, float y) const;
+
+		/// <summary>
+		/// <para>Calculates the noise of count coordinates starting at (x,y), each step units further along the x-axis</para> 
+		/// <para>The gradients of a grid cell are only calculated once for all the coordinates inside that cell</para> 
+		/// </summary>
+		void GetNoiseRow(float x, float y, float step, int count, float* pNoise) const;
+
+		/// <summary>
+		/// <para>Returns a conservative range [0,1] that contains every noise value inside the given rectangle</para> 
+		/// <para>The range is calculated from the octave multipliers and the gradients of the lattice cells the rectangle overlaps</para> 
+		/// </summary>
+		RangeFloat GetNoiseBounds(float minX, float minY, float maxX, float maxY) const;
+
 	private:
 		struct PerlinOctave
 		{
@@ -26,8 +46,12 @@ namespace that
 		};
 
 		float GetOctaveNoise(float x, float y, const PerlinOctave& octave) const;
+		NoiseSample GetOctaveNoiseWithDerivatives(float x, float y, const PerlinOctave& octave) const;
+		void AddOctaveNoiseRow(float x, float y, float step, int count, float* pNoise, const PerlinOctave& octave) const;
+		RangeFloat GetOctaveBounds(float minX, float minY, float maxX, float maxY, const PerlinOctave& octave) const;
 		Vector2Float GetRandomGradient(int ix, int iy) const;
 		float Lerp(float a, float b, float t) const;
+		RangeFloat LerpRange(const RangeFloat& a, const RangeFloat& b, const RangeFloat& t) const;
 		float Dot(const Vector2Float& a, const Vector2Float& b) const;
 
 		float m_MaxNoiseValue{};
@@ -35,5 +59,7 @@ namespace that
 
 		static const float m_MiddleOfNoise;
 		static const float m_MaxOctaveDisplacement;
+		static const int m_MaxBoundsCells;
+		static const float m_BoundsEpsilon;
 	};
 }
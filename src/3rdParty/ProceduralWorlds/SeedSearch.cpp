@@ -0,0 +1,50 @@
+#include "SeedSearch.h"
+
+#include "Generator.h"
+
+#include <execution>
+#include <algorithm>
+#include <thread>
+#include <memory>
+
+std::vector<unsigned int> that::SeedSearch::FindSeeds(const GeneratorFactory& createGenerator, int nrSeeds, int step, unsigned int firstSeed, unsigned int maxNrCandidates)
+{
+	std::vector<unsigned int> acceptedSeeds{};
+	if (nrSeeds <= 0) return acceptedSeeds;
+
+	// Test a few candidates per thread at once so every thread stays busy while generators are being created
+	const unsigned int batchSize{ std::max(std::thread::hardware_concurrency(), 1u) * 2 };
+
+	std::vector<std::unique_ptr<Generator>> generators{};
+	std::vector<char> isAccepted{};
+
+	for (unsigned int batchStart{}; batchStart < maxNrCandidates; batchStart += batchSize)
+	{
+		const unsigned int nrCandidates{ std::min(batchSize, maxNrCandidates - batchStart) };
+
+		// Create the generators of this batch in order, creating a generator changes the global random state
+		generators.clear();
+		for (unsigned int i{}; i < nrCandidates; ++i)
+		{
+			auto pGenerator{ std::make_unique<Generator>() };
+			createGenerator(*pGenerator, firstSeed + batchStart + i);
+			generators.push_back(std::move(pGenerator));
+		}
+
+		// Test the predicates of every candidate in parallel
+		isAccepted.assign(nrCandidates, false);
+		std::transform(std::execution::par, begin(generators), end(generators), begin(isAccepted),
+			[step](const std::unique_ptr<Generator>& pGenerator) -> char { return pGenerator->TryPredicates(step); });
+
+		// Collect the accepted seeds in order until enough seeds are found
+		for (unsigned int i{}; i < nrCandidates; ++i)
+		{
+			if (!isAccepted[i]) continue;
+
+			acceptedSeeds.push_back(firstSeed + batchStart + i);
+			if (static_cast<int>(acceptedSeeds.size()) == nrSeeds) return acceptedSeeds;
+		}
+	}
+
+	return acceptedSeeds;
+}
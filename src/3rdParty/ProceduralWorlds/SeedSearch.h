@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+namespace that
+{
+	class Generator;
+
+	class SeedSearch final
+	{
+	public:
+		// Fills an empty generator with the noise maps, shape and predicates of a world using the given seed
+		using GeneratorFactory = std::function<void(Generator& generator, unsigned int seed)>;
+
+		/// <summary>
+		/// <para>Returns the first nrSeeds seeds, starting from firstSeed, whose generator passes all its predicates</para> 
+		/// <para>The generators are created one by one because they rely on the global random state, 
+		///	their predicates are tested concurrently on a grid with the given step</para> 
+		/// <para>The search gives up after maxNrCandidates seeds, so less seeds can be returned</para> 
+		/// </summary>
+		static std::vector<unsigned int> FindSeeds(const GeneratorFactory& createGenerator, int nrSeeds, int step, unsigned int firstSeed = 0, unsigned int maxNrCandidates = 10'000);
+	};
+}
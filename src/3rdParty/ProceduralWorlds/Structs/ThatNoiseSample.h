@@ -0,0 +1,12 @@
+#pragma once
+
+namespace that
+{
+	// A noise value together with its partial derivatives along the x- and y-axis
+	struct NoiseSample final
+	{
+		float value{};
+		float dx{};
+		float dy{};
+	};
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace that
+{
+	struct RangeFloat final
+	{
+		float lower{};
+		float upper{};
+	};
+}
@@ -21,3 +21,9 @@ float that::shape::CirclePeak::Transform(float size, float x, float y, float hei
 	// Return the height with the applied distance fade
 	return height * std::max(mappedDistance, 0.0f);
 }
+
+void that::shape::CirclePeak::TransformBlock(float size, float originX, float originY, float step, std::span<float> heights) const
+{
+	// A circle is a rounded square with an angularity of 2
+	FadeBlock(size, originX, originY, step, 2.0f, m_SmoothPower, heights);
+}
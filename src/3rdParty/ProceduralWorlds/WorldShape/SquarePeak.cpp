@@ -22,3 +22,9 @@ float that::shape::SquarePeak::Transform(float size, float x, float y, float hei
 	// Return the height with the applied distance fade
 	return height * std::max(mappedDistance, 0.0f);
 }
+
+void that::shape::SquarePeak::TransformBlock(float size, float originX, float originY, float step, std::span<float> heights) const
+{
+	// Fade the heights with the distance from the center of the rounded square
+	FadeBlock(size, originX, originY, step, m_Angularity, m_SmoothPower, heights);
+}
@@ -16,6 +16,7 @@ namespace that::shape
 		virtual ~SquarePeak() = default;
 
 		virtual float Transform(float size, float x, float y, float height) const override;
+		virtual void TransformBlock(float size, float originX, float originY, float step, std::span<float> heights) const override;
 
 	private:
 		float m_SmoothPower{};
@@ -0,0 +1,93 @@
+#include "WorldShape.h"
+
+#include <cmath>
+#include <array>
+#include <algorithm>
+
+namespace
+{
+	// Raises a value to a whole exponent using a chain of multiplications
+	template<int Exponent>
+	struct IntegerPower final
+	{
+		float operator()(float value) const
+		{
+			if constexpr (Exponent == 1)
+			{
+				return value;
+			}
+			else
+			{
+				const float halfPower{ IntegerPower<Exponent / 2>{}(value) };
+				if constexpr (Exponent % 2 == 0) return halfPower * halfPower;
+				else return halfPower * halfPower * value;
+			}
+		}
+	};
+
+	struct FloatPower final
+	{
+		float exponent{};
+
+		float operator()(float value) const
+		{
+			return powf(value, exponent);
+		}
+	};
+
+	// Calls the function with the fastest power functor for this exponent
+	template<typename Function>
+	void DispatchPower(float exponent, const Function& function)
+	{
+		if (exponent == 1.0f) function(IntegerPower<1>{});
+		else if (exponent == 2.0f) function(IntegerPower<2>{});
+		else if (exponent == 3.0f) function(IntegerPower<3>{});
+		else if (exponent == 4.0f) function(IntegerPower<4>{});
+		else if (exponent == 5.0f) function(IntegerPower<5>{});
+		else if (exponent == 6.0f) function(IntegerPower<6>{});
+		else if (exponent == 7.0f) function(IntegerPower<7>{});
+		else if (exponent == 8.0f) function(IntegerPower<8>{});
+		else function(FloatPower{ exponent });
+	}
+}
+
+void that::shape::WorldShape::FadeBlock(float size, float originX, float originY, float step, float angularity, float smoothPower, std::span<float> heights)
+{
+	const float radius{ size / 2.0f };
+
+	// distance^smoothPower is written as (x^angularity + y^angularity)^(smoothPower/angularity), so no root is needed
+	const float fadePower{ smoothPower / angularity };
+
+	// The y-coordinate is the same for the whole row
+	float yDistance{};
+	DispatchPower(angularity, [&](auto power) { yDistance = power((originY - radius) / radius); });
+
+	// The row is processed in batches, first the distance of every sample is calculated and afterwards the fade is applied
+	//	Each loop only uses one kind of power, so they can be vectorized
+	std::array<float, 64> distances;
+
+	for (size_t batchStart{}; batchStart < heights.size(); batchStart += distances.size())
+	{
+		const size_t batchCount{ std::min(distances.size(), heights.size() - batchStart) };
+		const float batchX{ originX + static_cast<float>(batchStart) * step };
+
+		DispatchPower(angularity, [&](auto power)
+			{
+				for (size_t i{}; i < batchCount; ++i)
+				{
+					const float relativeX{ (batchX + static_cast<float>(i) * step - radius) / radius };
+					distances[i] = power(relativeX) + yDistance;
+				}
+			});
+
+		float* pHeights{ heights.data() + batchStart };
+		DispatchPower(fadePower, [&](auto power)
+			{
+				for (size_t i{}; i < batchCount; ++i)
+				{
+					// Map the distance to the function f(x)=-x^power+1 so the value tends to go to 1 faster
+					pHeights[i] *= std::max(1.0f - power(distances[i]), 0.0f);
+				}
+			});
+	}
+}
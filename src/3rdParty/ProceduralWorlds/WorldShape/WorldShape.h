@@ -1,5 +1,7 @@
 #pragma once
 
+#include <span>
+
 namespace that::shape
 {
 	class WorldShape
@@ -9,5 +11,21 @@ namespace that::shape
 		virtual ~WorldShape() = default;
 
 		virtual float Transform(float size, float x, float y, float height) const = 0;
+
+		/// <summary>
+		/// <para>Transforms a row of heights, starting at (originX,originY) with each height step units further along the x-axis</para> 
+		/// <para>By default every height is transformed separately, shapes can override this to transform the whole row at once</para> 
+		/// </summary>
+		virtual void TransformBlock(float size, float originX, float originY, float step, std::span<float> heights) const
+		{
+			for (size_t i{}; i < heights.size(); ++i)
+			{
+				heights[i] = Transform(size, originX + static_cast<float>(i) * step, originY, heights[i]);
+			}
+		}
+
+	protected:
+		// Multiplies each height with max(1 - distance^smoothPower, 0), where distance is (x^angularity + y^angularity)^(1/angularity) relative to the center
+		static void FadeBlock(float size, float originX, float originY, float step, float angularity, float smoothPower, std::span<float> heights);
 	};
-}
\ No newline at end of file
+}
@@ -51,6 +51,9 @@ void Erosion::RealtimeGenerator::Update()
 
 	if (m_PrevX == x && m_PrevZ == z) return;
 
+	// Erosion of chunks outside the new erosion area is paused until they get close to the player again
+	TerrainManager::GetInstance().SetErosionArea(x, z, m_ErosionRange);
+
 	for (int i{ static_cast<int>(m_Chunks.size()) - 1 }; i >= 0; --i)
 	{
 		const auto& chunk{ m_Chunks[i] };
@@ -68,7 +71,7 @@ void Erosion::RealtimeGenerator::Update()
 
 			if (it != end(m_Chunks))
 			{
-				TerrainManager::GetInstance().Generate(xPos, zPos, it->pTerrain, abs(xPos - x) < 5 && abs(zPos - z) < 5);
+				TerrainManager::GetInstance().Generate(xPos, zPos, it->pTerrain, abs(xPos - x) < m_ErosionRange && abs(zPos - z) < m_ErosionRange);
 				continue;
 			}
 
@@ -78,7 +81,7 @@ void Erosion::RealtimeGenerator::Update()
 			const int oldTerrainZ{ static_cast<int>(pTerrain->GetTransform()->GetLocalPosition().z / 256) };
 			pTerrain->GetTransform()->SetLocalPosition(static_cast<float>(xPos * 256), 0.0f, static_cast<float>(zPos * 256));
 			TerrainManager::GetInstance().Unregister(oldTerrainX, oldTerrainZ);
-			TerrainManager::GetInstance().Generate(xPos, zPos, pTerrain, abs(xPos - x) < 5 && abs(zPos - z) < 5);
+			TerrainManager::GetInstance().Generate(xPos, zPos, pTerrain, abs(xPos - x) < m_ErosionRange && abs(zPos - z) < m_ErosionRange);
 			m_Chunks.emplace_back(xPos, zPos, pTerrain);
 		}
 	}
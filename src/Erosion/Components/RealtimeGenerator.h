@@ -42,6 +42,7 @@ namespace Erosion
 		std::vector<leap::TerrainComponent*> m_Pool{};
 
 		int m_Range{ 10 };
+		int m_ErosionRange{ 5 };
 
 		float m_TimePerChunk{ 0.01f };
 		float m_CurTime{};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+namespace Erosion
+{
+	// Keeps the difference between the heights of a chunk and its generated noise in a compressed form
+	//	Changes are quantized, so the untouched parts of a chunk become long runs of zeros that are stored as a single number
+	class ChunkDeltaStore final
+	{
+	public:
+		ChunkDeltaStore(int chunkSize) : m_NrHeights{ chunkSize * chunkSize }
+		{
+		}
+
+		// Stores the change between the heights and the noise of a chunk, an existing change of the same chunk is replaced
+		void Store(int chunkX, int chunkY, const std::vector<float>& heights, const std::vector<float>& noise)
+		{
+			std::vector<uint8_t>& data{ m_Deltas[chunkX][chunkY] };
+			data.clear();
+
+			// Neighbouring changes are often alike, so every change is stored as the difference with the previous change
+			//	Each difference that isn't zero is written as the amount of zeros before it, followed by the difference itself
+			uint32_t nrZeros{};
+			int32_t previousChange{};
+			for (int i{}; i < m_NrHeights; ++i)
+			{
+				const int32_t curChange{ static_cast<int32_t>(std::lround((heights[i] - noise[i]) / m_Precision)) };
+				const int32_t change{ curChange - previousChange };
+				previousChange = curChange;
+				if (change == 0)
+				{
+					++nrZeros;
+					continue;
+				}
+
+				WriteVarint(data, nrZeros);
+				WriteVarint(data, ZigZag(change));
+				nrZeros = 0;
+			}
+
+			// The zeros at the end of the chunk
+			if (nrZeros > 0) WriteVarint(data, nrZeros);
+
+			data.shrink_to_fit();
+		}
+
+		// Adds the stored change of a chunk to its generated noise and removes it from the store, returns false if the chunk has no stored change
+		bool Restore(int chunkX, int chunkY, std::vector<float>& noise)
+		{
+			const auto rowIt{ m_Deltas.find(chunkX) };
+			if (rowIt == end(m_Deltas)) return false;
+			const auto chunkIt{ rowIt->second.find(chunkY) };
+			if (chunkIt == end(rowIt->second)) return false;
+
+			const std::vector<uint8_t>& data{ chunkIt->second };
+			size_t dataIdx{};
+			int32_t change{};
+			for (int i{}; i < m_NrHeights;)
+			{
+				const int nrZeros{ static_cast<int>(ReadVarint(data, dataIdx)) };
+				for (int zeroIdx{}; zeroIdx < nrZeros && i < m_NrHeights; ++zeroIdx)
+				{
+					noise[i++] += static_cast<float>(change) * m_Precision;
+				}
+				if (i >= m_NrHeights) break;
+
+				change += UnZigZag(ReadVarint(data, dataIdx));
+				noise[i++] += static_cast<float>(change) * m_Precision;
+			}
+
+			rowIt->second.erase(chunkIt);
+			if (rowIt->second.empty()) m_Deltas.erase(rowIt);
+
+			return true;
+		}
+
+		// Returns the amount of bytes used by the stored changes
+		size_t GetSize() const
+		{
+			size_t size{};
+			for (const auto& [chunkX, row] : m_Deltas)
+			{
+				for (const auto& [chunkY, data] : row)
+				{
+					size += data.size();
+				}
+			}
+			return size;
+		}
+
+		void Write(std::ostream& stream) const
+		{
+			for (const auto& [chunkX, row] : m_Deltas)
+			{
+				for (const auto& [chunkY, data] : row)
+				{
+					const int32_t header[3]{ chunkX, chunkY, static_cast<int32_t>(data.size()) };
+					stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+					stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+				}
+			}
+		}
+
+		void Read(std::istream& stream, int nrChunks)
+		{
+			for (int i{}; i < nrChunks; ++i)
+			{
+				int32_t header[3]{};
+				stream.read(reinterpret_cast<char*>(header), sizeof(header));
+				if (!stream || header[2] < 0) throw std::runtime_error("ChunkDeltaStore::Read: unexpected end of the delta data");
+
+				std::vector<uint8_t>& data{ m_Deltas[header[0]][header[1]] };
+				data.resize(header[2]);
+				stream.read(reinterpret_cast<char*>(data.data()), header[2]);
+				if (!stream) throw std::runtime_error("ChunkDeltaStore::Read: unexpected end of the delta data");
+			}
+		}
+
+		int GetNrChunks() const
+		{
+			int nrChunks{};
+			for (const auto& [chunkX, row] : m_Deltas)
+			{
+				nrChunks += static_cast<int>(row.size());
+			}
+			return nrChunks;
+		}
+
+	private:
+		// Maps small positive and negative numbers to small unsigned numbers, so both can be written with few bytes
+		static uint32_t ZigZag(int32_t value) { return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31); }
+		static int32_t UnZigZag(uint32_t value) { return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1); }
+
+		// Writes 7 bits per byte, the highest bit tells if another byte follows
+		static void WriteVarint(std::vector<uint8_t>& data, uint32_t value)
+		{
+			while (value >= 0x80)
+			{
+				data.push_back(static_cast<uint8_t>(value | 0x80));
+				value >>= 7;
+			}
+			data.push_back(static_cast<uint8_t>(value));
+		}
+
+		static uint32_t ReadVarint(const std::vector<uint8_t>& data, size_t& dataIdx)
+		{
+			uint32_t value{};
+			for (int shift{}; dataIdx < data.size(); shift += 7)
+			{
+				const uint8_t byte{ data[dataIdx++] };
+				value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0) break;
+			}
+			return value;
+		}
+
+		// The smallest height change that is kept
+		static constexpr float m_Precision{ 1.0f / 65536.0f };
+
+		int m_NrHeights{};
+		std::map<int, std::map<int, std::vector<uint8_t>>> m_Deltas{};
+	};
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Erosion
+{
+	// A random generator without state, every (counter, index) pair always gives the same number
+	//	This lets a simulation stop and continue later without storing more then the counter it reached
+	//	The key combines the seed of the world with a position (e.g. a chunk), so every world and every chunk get their own numbers
+	class CounterRandom final
+	{
+	public:
+		CounterRandom(uint32_t seed, int keyX, int keyY)
+			: m_Key{ Mix(Mix(seed) ^ static_cast<uint32_t>(keyX) * 0x9E3779B9u ^ Mix(static_cast<uint32_t>(keyY) + 0x7F4A7C15u)) }
+		{
+		}
+
+		// Returns a random number between [0,1) for the given counter, index selects one of the numbers that belong to the counter
+		float GetFloat01(uint32_t counter, uint32_t index) const
+		{
+			const uint32_t hash{ Mix(m_Key ^ Mix(counter * m_NrIndices + index)) };
+
+			// Use the highest 24 bits, these fit exactly inside a float
+			return static_cast<float>(hash >> 8) / 16777216.0f;
+		}
+
+	private:
+		// A 32-bit integer finalizer, every bit of the input changes about half of the output bits
+		static uint32_t Mix(uint32_t value)
+		{
+			value ^= value >> 16;
+			value *= 0x7FEB352Du;
+			value ^= value >> 15;
+			value *= 0x846CA68Bu;
+			value ^= value >> 16;
+			return value;
+		}
+
+		static constexpr uint32_t m_NrIndices{ 8 };
+
+		uint32_t m_Key{};
+	};
+}
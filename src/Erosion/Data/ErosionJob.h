@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ErosionStatistics.h"
+
+#include <vector>
+
+namespace Erosion
+{
+	// The progress of the erosion of a single chunk, so the erosion can be split up in slices and continued later
+	struct ErosionJob final
+	{
+		int chunkX{};
+		int chunkY{};
+
+		// The statistics also keep the amount of completed droplets, which is the counter of the random generator
+		ErosionStatistics statistics{};
+
+		// The progress of the batch that is currently being simulated
+		int nrBatchDroplets{};
+		float batchChange{};
+
+		// The chances of spawning a droplet in each block, calculated when the job starts
+		std::vector<float> spawnWeights{};
+
+		bool isStarted{};
+		bool isFinished{};
+	};
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+namespace Erosion
+{
+	// What the droplets of an erosion algorithm did, the counters of several jobs or threads can be added together
+	//	Every droplet that was taken from the terrain is either dropped again or lost when its droplet stops, so erodedSediment == depositedSediment + lostSediment
+	struct ErosionCounters final
+	{
+		float erodedSediment{};
+		float depositedSediment{};
+		float lostSediment{};
+
+		// The reasons why droplets stopped
+		int nrStoppedBySpeed{};
+		int nrStoppedByWater{};
+		int nrStoppedByPathLength{};
+		int nrStoppedByFlatGradient{};
+		int nrLeftTile{};
+
+		long long totalPathLength{};
+
+		ErosionCounters& operator+=(const ErosionCounters& other)
+		{
+			erodedSediment += other.erodedSediment;
+			depositedSediment += other.depositedSediment;
+			lostSediment += other.lostSediment;
+			nrStoppedBySpeed += other.nrStoppedBySpeed;
+			nrStoppedByWater += other.nrStoppedByWater;
+			nrStoppedByPathLength += other.nrStoppedByPathLength;
+			nrStoppedByFlatGradient += other.nrStoppedByFlatGradient;
+			nrLeftTile += other.nrLeftTile;
+			totalPathLength += other.totalPathLength;
+			return *this;
+		}
+
+		int GetNrStoppedDroplets() const { return nrStoppedBySpeed + nrStoppedByWater + nrStoppedByPathLength + nrStoppedByFlatGradient + nrLeftTile; }
+		float GetMeanPathLength() const
+		{
+			const int nrStoppedDroplets{ GetNrStoppedDroplets() };
+			return nrStoppedDroplets > 0 ? static_cast<float>(totalPathLength) / static_cast<float>(nrStoppedDroplets) : 0.0f;
+		}
+	};
+
+	// The amount of work an erosion algorithm spent on a single chunk
+	struct ErosionStatistics final
+	{
+		int nrDroplets{};
+		int nrBatches{};
+		float heightChange{};
+		float lastBatchChange{};
+		bool hasConverged{};
+
+		ErosionCounters counters{};
+	};
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Heightmap.h"
+
+#include <vector>
+
+namespace Erosion
+{
+	// A dense copy of a rectangle of the heightmap, so a simulation doesn't need to look up a chunk for every height
+	class HeightTile final
+	{
+	public:
+		HeightTile(int originX, int originY, int sizeX, int sizeY)
+			: m_OriginX{ originX }
+			, m_OriginY{ originY }
+			, m_SizeX{ sizeX }
+			, m_SizeY{ sizeY }
+			, m_Heights(sizeX * sizeY)
+		{
+		}
+
+		void Load(Heightmap& heightmap) { heightmap.ReadRegion(m_OriginX, m_OriginY, m_SizeX, m_SizeY, m_Heights.data()); }
+		void Store(Heightmap& heightmap) const { heightmap.WriteRegion(m_OriginX, m_OriginY, m_SizeX, m_SizeY, m_Heights.data()); }
+		void AddTo(Heightmap& heightmap) const { heightmap.AddRegion(m_OriginX, m_OriginY, m_SizeX, m_SizeY, m_Heights.data()); }
+
+		// Subtracts the heights of a tile with the same rectangle, which turns this tile into the change between both tiles
+		void Subtract(const HeightTile& other)
+		{
+			for (size_t i{}; i < m_Heights.size(); ++i)
+			{
+				m_Heights[i] -= other.m_Heights[i];
+			}
+		}
+
+		// Returns the height at the heightmap coordinate (x,y)
+		float& GetHeight(int x, int y) { return m_Heights[GetIndex(x, y)]; }
+		float GetHeight(int x, int y) const { return m_Heights[GetIndex(x, y)]; }
+
+		// Returns the index of the heightmap coordinate (x,y) inside the data of the tile
+		int GetIndex(int x, int y) const { return (x - m_OriginX) + (y - m_OriginY) * m_SizeX; }
+
+		// Returns if every coordinate within border cells of (x,y) lies inside the tile
+		bool Contains(int x, int y, int border) const
+		{
+			return x - border >= m_OriginX && y - border >= m_OriginY && x + border < m_OriginX + m_SizeX && y + border < m_OriginY + m_SizeY;
+		}
+
+		float* GetData() { return m_Heights.data(); }
+		const float* GetData() const { return m_Heights.data(); }
+		int GetOriginX() const { return m_OriginX; }
+		int GetOriginY() const { return m_OriginY; }
+		int GetSizeX() const { return m_SizeX; }
+		int GetSizeY() const { return m_SizeY; }
+
+	private:
+		int m_OriginX{};
+		int m_OriginY{};
+		int m_SizeX{};
+		int m_SizeY{};
+		std::vector<float> m_Heights{};
+	};
+}
@@ -3,18 +3,28 @@
 #include <map>
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
 
 #include <Generator.h>
 #include <Presets/Presets.h>
+#include <Expression/NoiseExpression.h>
+
+#include "ChunkDeltaStore.h"
 
 namespace Erosion
 {
 	class Heightmap final
 	{
 	public:
-		Heightmap(int chunkSize) : m_ChunkSize{ chunkSize }
+		// The noise only depends on the seed, so a heightmap with the same seed can load the changes that were saved by another
+		Heightmap(int chunkSize, unsigned int seed = static_cast<unsigned int>(time(nullptr)))
+			: m_ChunkSize{ chunkSize }
+			, m_Seed{ seed }
 		{
-			srand(static_cast<unsigned int>(time(nullptr)));
+			srand(m_Seed);
 
 			constexpr float multiplier{ 3.0f };
 
@@ -125,84 +135,281 @@ namespace Erosion
 			const int xInChunk{ x % m_ChunkSize };
 			const int yInChunk{ y % m_ChunkSize };
 
+			return GetChunk(chunkX, chunkY)[xInChunk + yInChunk * m_ChunkSize];
+		}
+
+		// Copies a rectangle of width by height heights starting at (x,y) into pHeights, row by row
+		void ReadRegion(int x, int y, int width, int height, float* pHeights)
+		{
+			ForEachRegionSpan(x, y, width, height, [pHeights, width](float* pChunkHeights, int regionX, int regionY, int spanLength)
+				{
+					std::copy(pChunkHeights, pChunkHeights + spanLength, pHeights + regionX + regionY * width);
+				});
+		}
+
+		// Copies a rectangle of width by height heights from pHeights into the heightmap, starting at (x,y)
+		void WriteRegion(int x, int y, int width, int height, const float* pHeights)
+		{
+			ForEachRegionSpan(x, y, width, height, [pHeights, width](float* pChunkHeights, int regionX, int regionY, int spanLength)
+				{
+					const float* pRegionHeights{ pHeights + regionX + regionY * width };
+					std::copy(pRegionHeights, pRegionHeights + spanLength, pChunkHeights);
+				});
+		}
+
+		// Adds a rectangle of width by height height changes starting at (x,y) to the heights, row by row
+		void AddRegion(int x, int y, int width, int height, const float* pChanges)
+		{
+			ForEachRegionSpan(x, y, width, height, [pChanges, width](float* pChunkHeights, int regionX, int regionY, int spanLength)
+				{
+					const float* pRegionChanges{ pChanges + regionX + regionY * width };
+					std::transform(pChunkHeights, pChunkHeights + spanLength, pRegionChanges, pChunkHeights, std::plus<float>{});
+				});
+		}
+
+		int GetSize() const { return m_ChunkSize; }
+		unsigned int GetSeed() const { return m_Seed; }
+
+		// Removes a chunk from memory and only keeps its difference with the noise, the chunk is restored the next time it is used
+		void EvictChunk(int chunkX, int chunkY)
+		{
+			const auto rowIt{ m_HeightmapPerChunk.find(chunkX) };
+			if (rowIt == end(m_HeightmapPerChunk)) return;
+			const auto chunkIt{ rowIt->second.find(chunkY) };
+			if (chunkIt == end(rowIt->second)) return;
+
+			if (!chunkIt->second.empty())
+			{
+				std::vector<float> noise{};
+				GenerateChunk(noise, chunkX, chunkY);
+				m_EvictedChunks.Store(chunkX, chunkY, chunkIt->second, noise);
+			}
+
+			rowIt->second.erase(chunkIt);
+			if (rowIt->second.empty()) m_HeightmapPerChunk.erase(rowIt);
+		}
+
+		// Evicts every chunk that doesn't overlap the rectangle from (minX,minY) to (maxX,maxY)
+		void EvictChunksOutside(int minX, int minY, int maxX, int maxY)
+		{
+			std::vector<std::pair<int, int>> evictedChunks{};
+			for (const auto& [chunkX, row] : m_HeightmapPerChunk)
+			{
+				for (const auto& [chunkY, chunk] : row)
+				{
+					const bool isOutside{ (chunkX + 1) * m_ChunkSize <= minX || chunkX * m_ChunkSize > maxX || (chunkY + 1) * m_ChunkSize <= minY || chunkY * m_ChunkSize > maxY };
+					if (isOutside) evictedChunks.emplace_back(chunkX, chunkY);
+				}
+			}
+
+			for (const auto& [chunkX, chunkY] : evictedChunks)
+			{
+				EvictChunk(chunkX, chunkY);
+			}
+		}
+
+		// Returns the amount of bytes used by the evicted chunks
+		size_t GetEvictedSize() const { return m_EvictedChunks.GetSize(); }
+
+		// Writes the changes of every chunk compared to the noise, the noise itself is created again when loading
+		void Save(std::ostream& stream) const
+		{
+			ChunkDeltaStore deltas{ m_EvictedChunks };
+
+			std::vector<float> noise{};
+			for (const auto& [chunkX, row] : m_HeightmapPerChunk)
+			{
+				for (const auto& [chunkY, chunk] : row)
+				{
+					if (chunk.empty()) continue;
+
+					GenerateChunk(noise, chunkX, chunkY);
+					deltas.Store(chunkX, chunkY, chunk, noise);
+				}
+			}
+
+			const int32_t header[3]{ static_cast<int32_t>(m_Seed), m_ChunkSize, deltas.GetNrChunks() };
+			stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+			deltas.Write(stream);
+		}
+
+		// Replaces all the heights by the saved changes, the saved heightmap must have the same seed and chunk size
+		void Load(std::istream& stream)
+		{
+			int32_t header[3]{};
+			stream.read(reinterpret_cast<char*>(header), sizeof(header));
+			if (!stream) throw std::runtime_error("Heightmap::Load: unexpected end of the heightmap data");
+			if (static_cast<unsigned int>(header[0]) != m_Seed || header[1] != m_ChunkSize) throw std::runtime_error("Heightmap::Load: the saved heightmap was created with a different seed or chunk size");
+
+			m_HeightmapPerChunk.clear();
+			m_EvictedChunks = ChunkDeltaStore{ m_ChunkSize };
+			m_EvictedChunks.Read(stream, header[2]);
+		}
+
+	private:
+		std::vector<float>& GetChunk(int chunkX, int chunkY)
+		{
 			auto& rowOfChunks{ m_HeightmapPerChunk[chunkX] };
 			auto& chunk{ rowOfChunks[chunkY] };
 
 			if (chunk.empty())
 			{
-				chunk.resize(m_ChunkSize * m_ChunkSize);
+				GenerateChunk(chunk, chunkX, chunkY);
+				m_EvictedChunks.Restore(chunkX, chunkY, chunk);
+			}
+
+			return chunk;
+		}
+
+		// Splits every row of the rectangle in the parts that lie inside a single chunk, 
+		//	so each part can be copied at once instead of looking up the chunk for every height
+		template<typename Function>
+		void ForEachRegionSpan(int x, int y, int width, int height, const Function& function)
+		{
+			for (int regionY{}; regionY < height; ++regionY)
+			{
+				const int curY{ y + regionY };
+				const int chunkY{ curY / m_ChunkSize };
+				const int yInChunk{ curY % m_ChunkSize };
+
+				for (int regionX{}; regionX < width;)
+				{
+					const int curX{ x + regionX };
+					const int chunkX{ curX / m_ChunkSize };
+					const int xInChunk{ curX % m_ChunkSize };
+					const int spanLength{ std::min(m_ChunkSize - xInChunk, width - regionX) };
+
+					function(GetChunk(chunkX, chunkY).data() + xInChunk + yInChunk * m_ChunkSize, regionX, regionY, spanLength);
+
+					regionX += spanLength;
+				}
+			}
+		}
+
+		void GenerateChunk(std::vector<float>& chunk, int chunkX, int chunkY) const
+		{
+			chunk.resize(m_ChunkSize * m_ChunkSize);
+
+			const int chunkOriginX{ chunkX * m_ChunkSize };
+			const int chunkOriginY{ chunkY * m_ChunkSize };
+
+			const int nrBlocks{ (m_ChunkSize + m_OceanBlockSize - 1) / m_OceanBlockSize };
+			std::vector<bool> isOceanBlock(nrBlocks);
+
+			for (int blockY{}; blockY < m_ChunkSize; blockY += m_OceanBlockSize)
+			{
+				const int blockEndY{ std::min(blockY + m_OceanBlockSize, m_ChunkSize) };
 
-				for (int curX{}; curX < m_ChunkSize; ++curX)
+				// If a whole block is proven to be ocean, the other noise maps don't need to be sampled
+				for (int blockIdx{}; blockIdx < nrBlocks; ++blockIdx)
 				{
-					for (int curY{}; curY < m_ChunkSize; ++curY)
+					const int blockX{ blockIdx * m_OceanBlockSize };
+					const int blockEndX{ std::min(blockX + m_OceanBlockSize, m_ChunkSize) };
+
+					const float blockMinX{ static_cast<float>(chunkOriginX + blockX) };
+					const float blockMinY{ static_cast<float>(chunkOriginY + blockY) };
+					const float blockMaxX{ static_cast<float>(chunkOriginX + blockEndX - 1) };
+					const float blockMaxY{ static_cast<float>(chunkOriginY + blockEndY - 1) };
+
+					isOceanBlock[blockIdx] = IsOcean(blockMinX, blockMinY, blockMaxX, blockMaxY);
+					if (!isOceanBlock[blockIdx]) continue;
+
+					for (int curY{ blockY }; curY < blockEndY; ++curY)
+					{
+						std::fill(begin(chunk) + blockX + curY * m_ChunkSize, begin(chunk) + blockEndX + curY * m_ChunkSize, m_OceanHeight);
+					}
+				}
+
+				// Generate each strip of neighbouring land blocks row by row
+				//	The ocean samples of a land strip pick the ocean height, so the mountain noise maps are only sampled for the land samples
+				for (int blockIdx{}; blockIdx < nrBlocks; ++blockIdx)
+				{
+					if (isOceanBlock[blockIdx]) continue;
+
+					const int stripStartX{ blockIdx * m_OceanBlockSize };
+					while (blockIdx + 1 < nrBlocks && !isOceanBlock[blockIdx + 1]) ++blockIdx;
+					const int stripEndX{ std::min((blockIdx + 1) * m_OceanBlockSize, m_ChunkSize) };
+					const int stripLength{ stripEndX - stripStartX };
+
+					for (int curY{ blockY }; curY < blockEndY; ++curY)
 					{
-						float continentalness{ m_Continentalness.GetNoise(static_cast<float>(curX + chunkX * m_ChunkSize), static_cast<float>((curY + chunkY * m_ChunkSize))) };
-						const float defaultDetails{ m_DefaultDetails.GetNoise(static_cast<float>(curX + chunkX * m_ChunkSize), static_cast<float>(curY + chunkY * m_ChunkSize)) };
-						continentalness += defaultDetails / 10.0f;
-
-						if (continentalness < 0.47f)
-						{
-							chunk[curX + curY * m_ChunkSize] = 0.02f;
-							continue;
-						}
-
-						continentalness -= 0.47f;
-						continentalness *= 1.3f;
-
-						float mountainness{ m_Mountainness.GetNoise(static_cast<float>(curX + chunkX * m_ChunkSize), static_cast<float>(curY + chunkY * m_ChunkSize)) };
-						if (mountainness < 0.5f)
-						{
-							mountainness = 0.0F;
-						}
-						else if(mountainness < 0.75f)
-						{
-							mountainness -= 0.5f;
-							mountainness /= 0.25f;
-
-							mountainness = mountainness * mountainness;
-
-							mountainness *= 0.85f;
-						}
-						else
-						{
-							mountainness -= 0.75f;
-							mountainness /= 0.25f;
-							mountainness *= 0.15f;
-							mountainness += 0.85f;
-						}
-						mountainness = std::max(mountainness, 1.5f * (continentalness / 0.6f - 0.3f));
-
-						float mountainRange{ m_MountainDiversity.GetNoise(static_cast<float>(curX + chunkX * m_ChunkSize), static_cast<float>(curY + chunkY * m_ChunkSize)) };
-						//const float mountainDetails{ m_MountainDetails.GetNoise(static_cast<float>(curX + chunkX * m_ChunkSize), static_cast<float>(curY + chunkY * m_ChunkSize)) };
-
-						float totalHeight{ continentalness };
-						if (totalHeight > 0.0f)
-						{
-							if (continentalness < 0.03f)
-							{
-								const float mountainFactor{ continentalness / 0.03f };
-								const float continentalFactor{ mountainFactor * mountainFactor };
-								totalHeight += continentalFactor * 0.03f * 2.0f * mountainness * mountainRange /** mountainDetails*/;
-							}
-							else
-							{
-								totalHeight += continentalness * 2.0f * mountainness * mountainRange /** mountainDetails*/;
-							}
-						}
-
-						chunk[curX + curY * m_ChunkSize] = totalHeight + 0.02f;
+						const float rowX{ static_cast<float>(chunkOriginX + stripStartX) };
+						const float rowY{ static_cast<float>(chunkOriginY + curY) };
+
+						that::expression::EvaluateRow(m_TerrainHeight, GetTerrainInputs(), rowX, rowY, 1.0f, stripLength, chunk.data() + stripStartX + curY * m_ChunkSize);
 					}
 				}
 			}
+		}
 
-			return chunk[xInChunk + yInChunk * m_ChunkSize];
+		bool IsOcean(float minX, float minY, float maxX, float maxY) const
+		{
+			// The continentalness can't exceed the sum of the upper bounds of its noise maps
+			const that::RangeFloat continentalBounds{ m_Continentalness.GetNoiseBounds(minX, minY, maxX, maxY) };
+			if (continentalBounds.upper >= m_OceanThreshold) return false;
+
+			const that::RangeFloat detailBounds{ m_DefaultDetails.GetNoiseBounds(minX, minY, maxX, maxY) };
+			return continentalBounds.upper + detailBounds.upper / 10.0f < m_OceanThreshold;
 		}
 
-		int GetSize() const { return m_ChunkSize; }
+		std::array<const that::NoiseMap*, 4> GetTerrainInputs() const
+		{
+			return { &m_Continentalness, &m_DefaultDetails, &m_Mountainness, &m_MountainDiversity };
+		}
+
+		// Chunks are generated in square blocks, blocks that are proven to be ocean skip most of the noise maps
+		static constexpr int m_OceanBlockSize{ 16 };
+		static constexpr float m_OceanThreshold{ 0.47f };
+		static constexpr float m_OceanHeight{ 0.02f };
+
+		// The inputs of the terrain expression, in the order of GetTerrainInputs
+		using Continentalness = that::expression::Input<0>;
+		using DefaultDetails = that::expression::Input<1>;
+		using Mountainness = that::expression::Input<2>;
+		using MountainDiversity = that::expression::Input<3>;
+
+		struct MountainCurve final
+		{
+			constexpr float operator()(float mountainness) const
+			{
+				if (mountainness < 0.5f) return 0.0f;
+
+				if (mountainness < 0.75f)
+				{
+					const float steepness{ (mountainness - 0.5f) / 0.25f };
+					return steepness * steepness * 0.85f;
+				}
+
+				return (mountainness - 0.75f) / 0.25f * 0.15f + 0.85f;
+			}
+		};
+
+		// Flattens the mountains close to the coast
+		struct CoastCurve final
+		{
+			constexpr float operator()(float continentalness) const
+			{
+				if (continentalness >= 0.03f) return continentalness;
+
+				const float mountainFactor{ continentalness / 0.03f };
+				return mountainFactor * mountainFactor * 0.03f;
+			}
+		};
+
+		static constexpr auto m_Coastline{ Continentalness{} + DefaultDetails{} / 10.0f };
+		static constexpr auto m_Land{ (m_Coastline - m_OceanThreshold) * 1.3f };
+		static constexpr auto m_Mountains{ that::expression::Max(that::expression::MapCurve(Mountainness{}, MountainCurve{}), 1.5f * (m_Land / 0.6f - 0.3f)) };
+		static constexpr auto m_TerrainHeight
+		{
+			that::expression::IfBelow(m_Coastline, m_OceanThreshold,
+				m_OceanHeight,
+				m_Land + that::expression::MapCurve(m_Land, CoastCurve{}) * 2.0f * m_Mountains * MountainDiversity{} + m_OceanHeight)
+		};
 
-	private:
 		int m_ChunkSize{};
+		unsigned int m_Seed{};
 		std::map<int, std::map<int, std::vector<float>>> m_HeightmapPerChunk{};
+		ChunkDeltaStore m_EvictedChunks{ m_ChunkSize };
 		that::Generator m_Perlin{};
 		const float m_PerlinMultiplier{ /*23.726f*/900 };
 
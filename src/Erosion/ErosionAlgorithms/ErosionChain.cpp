@@ -0,0 +1,81 @@
+#include "ErosionChain.h"
+
+#include <stdexcept>
+#include <utility>
+
+Erosion::ErosionChain::ErosionChain(std::unique_ptr<ITerrainGenerator> pFirstGenerator)
+	: m_pFirstGenerator{ std::move(pFirstGenerator) }
+{
+	if (!m_pFirstGenerator) throw std::runtime_error("An erosion chain needs a first generator");
+}
+
+void Erosion::ErosionChain::AddStage(std::unique_ptr<ITerrainGenerator> pStage)
+{
+	if (!pStage) throw std::runtime_error("Can't add an empty stage to an erosion chain");
+
+	m_pStages.push_back(std::move(pStage));
+}
+
+void Erosion::ErosionChain::SetChunk(int x, int y)
+{
+	m_pFirstGenerator->SetChunk(x, y);
+	for (const auto& pStage : m_pStages)
+	{
+		pStage->SetChunk(x, y);
+	}
+}
+
+void Erosion::ErosionChain::GetHeights(Heightmap& heights)
+{
+	m_pFirstGenerator->GetHeights(heights);
+	for (const auto& pStage : m_pStages)
+	{
+		pStage->GetHeights(heights);
+	}
+}
+
+bool Erosion::ErosionChain::Resume(Heightmap& heights, ErosionJob& job, int maxWork)
+{
+	if (job.isFinished) return true;
+
+	if (!m_pFirstGenerator->Resume(heights, job, maxWork)) return false;
+
+	RunStages(heights, job.chunkX, job.chunkY);
+	return true;
+}
+
+void Erosion::ErosionChain::ResumeParallel(Heightmap& heights, const std::vector<ErosionJob*>& jobs, int maxWork)
+{
+	// Only the jobs that finish during this slice still need the stages
+	std::vector<ErosionJob*> pUnfinishedJobs{};
+	for (ErosionJob* pJob : jobs)
+	{
+		if (!pJob->isFinished) pUnfinishedJobs.push_back(pJob);
+	}
+
+	m_pFirstGenerator->ResumeParallel(heights, pUnfinishedJobs, maxWork);
+
+	// The stages run after every job of the slice added its changes, so they see the same heights no matter how the jobs were divided
+	for (const ErosionJob* pJob : pUnfinishedJobs)
+	{
+		if (pJob->isFinished) RunStages(heights, pJob->chunkX, pJob->chunkY);
+	}
+}
+
+void Erosion::ErosionChain::OnGUI()
+{
+	m_pFirstGenerator->OnGUI();
+	for (const auto& pStage : m_pStages)
+	{
+		pStage->OnGUI();
+	}
+}
+
+void Erosion::ErosionChain::RunStages(Heightmap& heights, int chunkX, int chunkY)
+{
+	for (const auto& pStage : m_pStages)
+	{
+		pStage->SetChunk(chunkX, chunkY);
+		pStage->GetHeights(heights);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ITerrainGenerator.h"
+
+#include <memory>
+#include <vector>
+
+namespace Erosion
+{
+	// Runs several generators one after another on every chunk
+	//	The first generator can be resumed in slices, the stages after it run on the whole chunk once the first generator finished the chunk
+	class ErosionChain final : public ITerrainGenerator
+	{
+	public:
+		explicit ErosionChain(std::unique_ptr<ITerrainGenerator> pFirstGenerator);
+		virtual ~ErosionChain() = default;
+
+		ErosionChain(const ErosionChain& other) = delete;
+		ErosionChain(ErosionChain&& other) = delete;
+		ErosionChain& operator=(const ErosionChain& other) = delete;
+		ErosionChain& operator=(ErosionChain&& other) = delete;
+
+		// Adds a generator that runs after the generators that were added before it
+		void AddStage(std::unique_ptr<ITerrainGenerator> pStage);
+
+		virtual void SetChunk(int x, int y) override;
+		virtual void GetHeights(Heightmap& heights) override;
+		virtual bool Resume(Heightmap& heights, ErosionJob& job, int maxWork) override;
+		virtual void ResumeParallel(Heightmap& heights, const std::vector<ErosionJob*>& jobs, int maxWork) override;
+
+		virtual void OnGUI() override;
+		virtual ErosionStatistics GetStatistics() const override { return m_pFirstGenerator->GetStatistics(); }
+
+	private:
+		void RunStages(Heightmap& heights, int chunkX, int chunkY);
+
+		std::unique_ptr<ITerrainGenerator> m_pFirstGenerator{};
+		std::vector<std::unique_ptr<ITerrainGenerator>> m_pStages{};
+	};
+}
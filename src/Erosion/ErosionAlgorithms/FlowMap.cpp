@@ -0,0 +1,154 @@
+#include "FlowMap.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <utility>
+
+Erosion::FlowMap::FlowMap(const HeightTile& tile)
+	: m_OriginX{ tile.GetOriginX() }
+	, m_OriginY{ tile.GetOriginY() }
+	, m_SizeX{ tile.GetSizeX() }
+	, m_SizeY{ tile.GetSizeY() }
+	, m_Receivers(tile.GetSizeX() * tile.GetSizeY())
+	, m_Accumulations(m_Receivers.size())
+{
+	CalculateReceivers(tile);
+	CalculateAccumulations();
+}
+
+Erosion::FlowMap Erosion::FlowMap::CalculateRegion(Heightmap& heights, int firstChunkX, int firstChunkY, int nrChunksX, int nrChunksY, int haloSize)
+{
+	// Terrain data
+	const int terrainSize{ heights.GetSize() };
+
+	// Neighbouring chunks share their edge, so the region is one cell larger than its chunks without that edge
+	const int originX{ terrainSize / 2 + firstChunkX * (terrainSize - 1) - haloSize };
+	const int originY{ terrainSize / 2 + firstChunkY * (terrainSize - 1) - haloSize };
+	const int sizeX{ nrChunksX * (terrainSize - 1) + 1 + 2 * haloSize };
+	const int sizeY{ nrChunksY * (terrainSize - 1) + 1 + 2 * haloSize };
+
+	HeightTile tile{ originX, originY, sizeX, sizeY };
+	tile.Load(heights);
+	return FlowMap{ tile };
+}
+
+void Erosion::FlowMap::CalculateReceivers(const HeightTile& tile)
+{
+	const float* pHeights{ tile.GetData() };
+
+	// Every cell only reads the heights around it and writes its own receiver, so the bands don't wait for each other
+	ForEachBand([&](int firstY, int endY)
+		{
+			for (int y{ firstY }; y < endY; ++y)
+			{
+				for (int x{}; x < m_SizeX; ++x)
+				{
+					const int cellIdx{ x + y * m_SizeX };
+
+					// Find the neighbour with the steepest descent, diagonal neighbours are further away
+					int receiverIdx{ -1 };
+					float steepestDescent{};
+					for (int neighbourIdx{}; neighbourIdx < m_NrNeighbours; ++neighbourIdx)
+					{
+						const int neighbourX{ x + m_NeighbourOffsetsX[neighbourIdx] };
+						const int neighbourY{ y + m_NeighbourOffsetsY[neighbourIdx] };
+						if (neighbourX < 0 || neighbourY < 0 || neighbourX >= m_SizeX || neighbourY >= m_SizeY) continue;
+
+						const int otherIdx{ neighbourX + neighbourY * m_SizeX };
+						const float distance{ m_NeighbourOffsetsX[neighbourIdx] != 0 && m_NeighbourOffsetsY[neighbourIdx] != 0 ? 1.41421356f : 1.0f };
+						const float descent{ (pHeights[cellIdx] - pHeights[otherIdx]) / distance };
+						if (descent <= steepestDescent) continue;
+
+						steepestDescent = descent;
+						receiverIdx = otherIdx;
+					}
+
+					m_Receivers[cellIdx] = receiverIdx;
+				}
+			}
+		});
+}
+
+void Erosion::FlowMap::CalculateAccumulations()
+{
+	// Count the donors of every cell by looking at the receivers of its neighbours, so no two threads write to the same cell
+	std::vector<uint8_t> nrWaitingDonors(m_Receivers.size());
+	ForEachBand([&](int firstY, int endY)
+		{
+			for (int cellIdx{ firstY * m_SizeX }; cellIdx < endY * m_SizeX; ++cellIdx)
+			{
+				nrWaitingDonors[cellIdx] = static_cast<uint8_t>(CountDonors(cellIdx));
+			}
+		});
+
+	// The cells without donors are ready first
+	std::vector<int> readyCells{};
+	for (int cellIdx{}; cellIdx < static_cast<int>(nrWaitingDonors.size()); ++cellIdx)
+	{
+		if (nrWaitingDonors[cellIdx] == 0) readyCells.push_back(cellIdx);
+	}
+
+	std::vector<int> nextReadyCells{};
+	while (!readyCells.empty())
+	{
+		// Every ready cell adds up the water of its donors, which were all ready in an earlier round
+		//	A cell only writes its own accumulation, so the ready cells of a round can be handled in parallel
+		std::for_each(std::execution::par, begin(readyCells), end(readyCells), [this](int cellIdx)
+			{
+				const int x{ cellIdx % m_SizeX };
+				const int y{ cellIdx / m_SizeX };
+
+				int accumulation{ 1 };
+				for (int neighbourIdx{}; neighbourIdx < m_NrNeighbours; ++neighbourIdx)
+				{
+					const int neighbourX{ x + m_NeighbourOffsetsX[neighbourIdx] };
+					const int neighbourY{ y + m_NeighbourOffsetsY[neighbourIdx] };
+					if (neighbourX < 0 || neighbourY < 0 || neighbourX >= m_SizeX || neighbourY >= m_SizeY) continue;
+
+					const int otherIdx{ neighbourX + neighbourY * m_SizeX };
+					if (m_Receivers[otherIdx] == cellIdx) accumulation += m_Accumulations[otherIdx];
+				}
+				m_Accumulations[cellIdx] = accumulation;
+			});
+
+		// A receiver is ready in the next round once its last donor is ready
+		//	Every cell has a single receiver, so a receiver is only added once
+		nextReadyCells.clear();
+		for (const int cellIdx : readyCells)
+		{
+			const int receiverIdx{ m_Receivers[cellIdx] };
+			if (receiverIdx >= 0 && --nrWaitingDonors[receiverIdx] == 0) nextReadyCells.push_back(receiverIdx);
+		}
+		std::swap(readyCells, nextReadyCells);
+	}
+}
+
+int Erosion::FlowMap::CountDonors(int cellIdx) const
+{
+	const int x{ cellIdx % m_SizeX };
+	const int y{ cellIdx / m_SizeX };
+
+	int nrDonors{};
+	for (int neighbourIdx{}; neighbourIdx < m_NrNeighbours; ++neighbourIdx)
+	{
+		const int neighbourX{ x + m_NeighbourOffsetsX[neighbourIdx] };
+		const int neighbourY{ y + m_NeighbourOffsetsY[neighbourIdx] };
+		if (neighbourX < 0 || neighbourY < 0 || neighbourX >= m_SizeX || neighbourY >= m_SizeY) continue;
+
+		if (m_Receivers[neighbourX + neighbourY * m_SizeX] == cellIdx) ++nrDonors;
+	}
+	return nrDonors;
+}
+
+template<typename Function>
+void Erosion::FlowMap::ForEachBand(const Function& function) const
+{
+	const int nrBands{ (m_SizeY + m_BandHeight - 1) / m_BandHeight };
+	std::vector<int> bandIndices(nrBands);
+	std::iota(begin(bandIndices), end(bandIndices), 0);
+	std::for_each(std::execution::par, begin(bandIndices), end(bandIndices), [&](int bandIdx)
+		{
+			function(bandIdx * m_BandHeight, std::min((bandIdx + 1) * m_BandHeight, m_SizeY));
+		});
+}
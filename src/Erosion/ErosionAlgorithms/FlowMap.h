@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../Data/HeightTile.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace Erosion
+{
+	// Where the water of a tile drains to, every cell drains to the neighbour with the steepest descent (D8)
+	//	Cells without a lower neighbour are sinks, cells at the edge of the tile only drain to cells inside the tile
+	class FlowMap final
+	{
+	public:
+		explicit FlowMap(const HeightTile& tile);
+
+		// Calculates the flow of a rectangle of chunks with a halo of cells from the neighbouring chunks around it
+		//	The halo lets the cells at the edge of the region drain into the neighbouring chunks, and water from the halo flows into the region
+		static FlowMap CalculateRegion(Heightmap& heights, int firstChunkX, int firstChunkY, int nrChunksX, int nrChunksY, int haloSize);
+
+		// Returns the index of the heightmap coordinate (x,y) inside the flow map
+		int GetIndex(int x, int y) const { return (x - m_OriginX) + (y - m_OriginY) * m_SizeX; }
+		// Returns the index of the cell that the cell drains to, or -1 if the cell is a sink
+		int GetReceiver(int cellIdx) const { return m_Receivers[cellIdx]; }
+		// Returns the amount of cells that drain through the cell, the cell itself included
+		int GetAccumulation(int cellIdx) const { return m_Accumulations[cellIdx]; }
+		const std::vector<int>& GetAccumulations() const { return m_Accumulations; }
+
+		int GetOriginX() const { return m_OriginX; }
+		int GetOriginY() const { return m_OriginY; }
+		int GetSizeX() const { return m_SizeX; }
+		int GetSizeY() const { return m_SizeY; }
+
+	private:
+		void CalculateReceivers(const HeightTile& tile);
+		// Sorts the cells so every cell comes after all the cells that drain into it, and adds up the water in that order
+		//	A cell is ready once all of its donors are ready, so every round handles the cells whose last donor was ready in the round before
+		void CalculateAccumulations();
+		// Returns how many cells drain directly into the cell
+		int CountDonors(int cellIdx) const;
+
+		// Calls the function with the first and end row of every band of rows, the bands are divided over the threads
+		template<typename Function>
+		void ForEachBand(const Function& function) const;
+
+		// The amount of rows that a thread handles at once
+		static constexpr int m_BandHeight{ 16 };
+		// The neighbours of a cell, in the order they are checked, so ties between equal descents always go to the same neighbour
+		static constexpr int m_NrNeighbours{ 8 };
+		static constexpr int m_NeighbourOffsetsX[m_NrNeighbours]{ -1, 0, 1, -1, 1, -1, 0, 1 };
+		static constexpr int m_NeighbourOffsetsY[m_NrNeighbours]{ -1, -1, -1, 0, 0, 1, 1, 1 };
+
+		int m_OriginX{};
+		int m_OriginY{};
+		int m_SizeX{};
+		int m_SizeY{};
+
+		std::vector<int> m_Receivers{};
+		std::vector<int> m_Accumulations{};
+	};
+}
@@ -1,4 +1,5 @@
 #include "HansBeyer.h"
+#include "FlowMap.h"
 
 #include <vec2.hpp>
 #include <ext/scalar_constants.hpp>
@@ -6,8 +7,186 @@
 
 #include <ImGui/imgui.h>
 
+#include <array>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <numeric>
+#include <execution>
+#include <tuple>
+
 void Erosion::HansBeyer::GetHeights(Heightmap& heights)
 {
+	// Erode the whole chunk in a single slice
+	ErosionJob job{ m_ChunkX, m_ChunkY };
+	Resume(heights, job, INT_MAX);
+}
+
+bool Erosion::HansBeyer::Resume(Heightmap& heights, ErosionJob& job, int maxNrDroplets)
+{
+	SetChunk(job.chunkX, job.chunkY);
+
+	// Terrain data
+	const int terrainSize{ heights.GetSize() };
+
+	// The tile is loaded again for every slice, so changes made by other chunks in between slices are never overwritten
+	HeightTile tile{ CreateTile(job.chunkX, job.chunkY, terrainSize) };
+	tile.Load(heights);
+
+	m_TotalCounters += ErodeTile(tile, terrainSize, heights.GetSeed(), job, maxNrDroplets);
+
+	tile.Store(heights);
+
+	m_Statistics = job.statistics;
+	return job.isFinished;
+}
+
+void Erosion::HansBeyer::ResumeParallel(Heightmap& heights, const std::vector<ErosionJob*>& jobs, int maxNrDroplets)
+{
+	// Terrain data
+	const int terrainSize{ heights.GetSize() };
+
+	// The changes are added in the order of the chunks, so the result doesn't depend on the order of the jobs or the amount of threads
+	std::vector<ErosionJob*> sortedJobs{ jobs };
+	std::sort(begin(sortedJobs), end(sortedJobs), [](const ErosionJob* pJobA, const ErosionJob* pJobB)
+		{
+			return std::tie(pJobA->chunkX, pJobA->chunkY) < std::tie(pJobB->chunkX, pJobB->chunkY);
+		});
+
+	// Every job gets a snapshot of the heightmap from before any of the jobs started
+	//	Loading happens on this thread, because the heightmap creates missing chunks while reading
+	std::vector<HeightTile> snapshots{};
+	snapshots.reserve(sortedJobs.size());
+	for (const ErosionJob* pJob : sortedJobs)
+	{
+		snapshots.push_back(CreateTile(pJob->chunkX, pJob->chunkY, terrainSize));
+		snapshots.back().Load(heights);
+	}
+
+	// Erode every tile and turn it into the change that the job made
+	std::vector<HeightTile> deltas{ snapshots };
+	std::vector<ErosionCounters> jobCounters(sortedJobs.size());
+	std::vector<int> jobIndices(sortedJobs.size());
+	std::iota(begin(jobIndices), end(jobIndices), 0);
+	std::for_each(std::execution::par, begin(jobIndices), end(jobIndices), [&](int jobIdx)
+		{
+			jobCounters[jobIdx] = ErodeTile(deltas[jobIdx], terrainSize, heights.GetSeed(), *sortedJobs[jobIdx], maxNrDroplets);
+			deltas[jobIdx].Subtract(snapshots[jobIdx]);
+		});
+
+	// Merge the changes and the counters of all the jobs
+	for (const HeightTile& delta : deltas)
+	{
+		delta.AddTo(heights);
+	}
+	for (const ErosionCounters& counters : jobCounters)
+	{
+		m_TotalCounters += counters;
+	}
+
+	if (!sortedJobs.empty()) m_Statistics = sortedJobs.back()->statistics;
+}
+
+Erosion::ErosionCounters Erosion::HansBeyer::ErodeTile(HeightTile& tile, int terrainSize, unsigned int seed, ErosionJob& job, int maxNrDroplets) const
+{
+	if (!job.isStarted)
+	{
+		// Spawn more droplets in the parts of the chunk with the most relief
+		//	The weights are only calculated when the job starts, so every slice spawns its droplets the same way
+		if (m_UseAdaptiveCycles) job.spawnWeights = CalculateSpawnWeights(tile, terrainSize, job.chunkX, job.chunkY);
+		job.isStarted = true;
+	}
+
+	ErosionStatistics& statistics{ job.statistics };
+	ErosionCounters sliceCounters{};
+	const CounterRandom random{ seed, job.chunkX, job.chunkY };
+
+	// Keep simulating droplets until the job is finished or the slice is used up
+	int nrSliceDroplets{};
+	while (!job.isFinished && nrSliceDroplets < maxNrDroplets)
+	{
+		if (statistics.nrDroplets >= m_Cycles)
+		{
+			job.isFinished = true;
+			break;
+		}
+
+		// Without adaptive cycles, all cycles form a single batch
+		const int batchSize{ m_UseAdaptiveCycles ? m_AdaptiveBatchSize : m_Cycles };
+		const int nrDroplets{ std::min({ batchSize - job.nrBatchDroplets, m_Cycles - statistics.nrDroplets, maxNrDroplets - nrSliceDroplets }) };
+
+		const ErosionCounters counters{ Simulate(tile, terrainSize, job, random, nrDroplets) };
+		const float heightChange{ counters.erodedSediment + counters.depositedSediment };
+
+		sliceCounters += counters;
+		statistics.counters += counters;
+		statistics.nrDroplets += nrDroplets;
+		statistics.heightChange += heightChange;
+		job.nrBatchDroplets += nrDroplets;
+		job.batchChange += heightChange;
+		nrSliceDroplets += nrDroplets;
+
+		// Wait for the rest of the batch if the slice ended in the middle of it
+		if (job.nrBatchDroplets < batchSize && statistics.nrDroplets < m_Cycles) continue;
+
+		++statistics.nrBatches;
+		statistics.lastBatchChange = job.batchChange;
+
+		// Compare the average change of a single droplet, so the threshold doesn't depend on the batch size
+		if (m_UseAdaptiveCycles && job.batchChange / static_cast<float>(job.nrBatchDroplets) < m_ConvergenceThreshold)
+		{
+			statistics.hasConverged = true;
+			job.isFinished = true;
+		}
+
+		job.nrBatchDroplets = 0;
+		job.batchChange = 0.0f;
+
+		if (statistics.nrDroplets >= m_Cycles) job.isFinished = true;
+	}
+
+	return sliceCounters;
+}
+
+Erosion::HeightTile Erosion::HansBeyer::CreateTile(int chunkX, int chunkY, int terrainSize) const
+{
+	// Copy every height a droplet of this chunk can reach into a tile
+	//	A droplet moves one cell per step and erodes up to the erosion radius around its position
+	const int tileMargin{ m_MaxPathLength + m_ErosionRadius + 2 };
+	const int tileOriginX{ std::max(terrainSize / 2 + chunkX * (terrainSize - 1) - tileMargin, 0) };
+	const int tileOriginY{ std::max(terrainSize / 2 + chunkY * (terrainSize - 1) - tileMargin, 0) };
+	const int tileEndX{ terrainSize / 2 + (chunkX + 1) * (terrainSize - 1) + tileMargin };
+	const int tileEndY{ terrainSize / 2 + (chunkY + 1) * (terrainSize - 1) + tileMargin };
+
+	return HeightTile{ tileOriginX, tileOriginY, tileEndX - tileOriginX + 1, tileEndY - tileOriginY + 1 };
+}
+
+Erosion::ErosionCounters Erosion::HansBeyer::Simulate(HeightTile& tile, int terrainSize, const ErosionJob& job, const CounterRandom& random, int nrDroplets) const
+{
+	switch (m_ErosionRadius)
+	{
+	case 2: return Simulate<2>(tile, terrainSize, job, random, nrDroplets);
+	case 3: return Simulate<3>(tile, terrainSize, job, random, nrDroplets);
+	case 4: return Simulate<4>(tile, terrainSize, job, random, nrDroplets);
+	case 5: return Simulate<5>(tile, terrainSize, job, random, nrDroplets);
+	case 6: return Simulate<6>(tile, terrainSize, job, random, nrDroplets);
+	case 7: return Simulate<7>(tile, terrainSize, job, random, nrDroplets);
+	case 8: return Simulate<8>(tile, terrainSize, job, random, nrDroplets);
+	default: return Simulate<0>(tile, terrainSize, job, random, nrDroplets);
+	}
+}
+
+template<int Radius>
+Erosion::ErosionCounters Erosion::HansBeyer::Simulate(HeightTile& tile, int terrainSize, const ErosionJob& job, const CounterRandom& random, int nrDroplets) const
+{
+	return m_UseDropletBatches ? SimulateDropletBatches<Radius>(tile, terrainSize, job, random, nrDroplets) : SimulateDroplets<Radius>(tile, terrainSize, job, random, nrDroplets);
+}
+
+template<int Radius>
+Erosion::ErosionCounters Erosion::HansBeyer::SimulateDroplets(HeightTile& tile, int terrainSize, const ErosionJob& job, const CounterRandom& random, int nrDroplets) const
+{
+	const int firstDropletIdx{ job.statistics.nrDroplets };
+
 	struct Droplet 
 	{
 		glm::vec2 position{};
@@ -18,27 +197,21 @@ void Erosion::HansBeyer::GetHeights(Heightmap& heights)
 		int pathLength{};
 	};
 
-	// Terrain data
-	const int terrainSize{ heights.GetSize() };
-
 	// Erosion radius data
-	std::vector<float> radiusWeights{};
-	radiusWeights.resize(m_ErosionRadius * m_ErosionRadius);
+	BrushWeights<Radius> radiusWeights{};
+	if constexpr (Radius == 0) radiusWeights.resize(m_ErosionRadius * m_ErosionRadius);
+
+	ErosionCounters counters{};
 
 	// X cycles
-	for (int cycleIdx{}; cycleIdx < m_Cycles; ++cycleIdx)
+	for (int cycleIdx{}; cycleIdx < nrDroplets; ++cycleIdx)
 	{
 		// Create a droplet
-		const float angle{ Random01() * glm::pi<float>() };
-		Droplet droplet
-		{
-			glm::vec2{ terrainSize / 2 + m_ChunkX * (terrainSize - 1) + Random01() * (terrainSize - 1), terrainSize / 2 + m_ChunkY * (terrainSize - 1) + Random01() * (terrainSize - 1) },
-			glm::vec2{ cosf(angle), sinf(angle) },
-			1.0f,
-			1.0f,
-			0.0f,
-			0
-		};
+		Droplet droplet{ {}, {}, 1.0f, 1.0f, 0.0f, 0 };
+		SpawnDroplet(terrainSize, job, random, firstDropletIdx + cycleIdx, droplet.position.x, droplet.position.y, droplet.direction.x, droplet.direction.y);
+
+		// The counter of the reason why the droplet stops
+		int* pStopReason{ &counters.nrStoppedByPathLength };
 
 		for (int lifeTime{}; lifeTime < m_MaxPathLength; ++lifeTime)
 		{
@@ -49,10 +222,10 @@ void Erosion::HansBeyer::GetHeights(Heightmap& heights)
 			const float cellPosY{ droplet.position.y - gridPosY };
 
 			// Calculate the height of all the neighbouring cells around the droplet position
-			const float heightXY{ heights.GetHeight(gridPosX, gridPosY) };
-			const float heightXPlusY{ heights.GetHeight(gridPosX + 1, gridPosY) };
-			const float heightXYPlus{ heights.GetHeight(gridPosX, gridPosY + 1) };
-			const float heightXPlusYPlus{ heights.GetHeight(gridPosX + 1, gridPosY + 1) };
+			const float heightXY{ tile.GetHeight(gridPosX, gridPosY) };
+			const float heightXPlusY{ tile.GetHeight(gridPosX + 1, gridPosY) };
+			const float heightXYPlus{ tile.GetHeight(gridPosX, gridPosY + 1) };
+			const float heightXPlusYPlus{ tile.GetHeight(gridPosX + 1, gridPosY + 1) };
 
 			// Calculate the gradient at the droplet position
 			const glm::vec2 gradient
@@ -65,8 +238,12 @@ void Erosion::HansBeyer::GetHeights(Heightmap& heights)
 
 			// Calculate the new direction and position of the droplet
 			droplet.direction = droplet.direction * m_Inertia - gradient * (1.0f - m_Inertia);
-			if (glm::dot(droplet.direction, droplet.direction) < FLT_EPSILON) break;
-			else droplet.direction = glm::normalize(droplet.direction);
+			if (glm::dot(droplet.direction, droplet.direction) < FLT_EPSILON)
+			{
+				pStopReason = &counters.nrStoppedByFlatGradient;
+				break;
+			}
+			droplet.direction = glm::normalize(droplet.direction);
 			droplet.position = droplet.position + droplet.direction;
 
 			// Calculate grid position and position inside cell of the new droplet position
@@ -75,11 +252,21 @@ void Erosion::HansBeyer::GetHeights(Heightmap& heights)
 			const float newCellPosX{ droplet.position.x - newGridPosX };
 			const float newCellPosY{ droplet.position.y - newGridPosY };
 
+			// If the droplet leaves the tile, disable the droplet
+			if (!tile.Contains(newGridPosX, newGridPosY, m_ErosionRadius))
+			{
+				pStopReason = &counters.nrLeftTile;
+				break;
+			}
+
+			// Increase the life time of the droplet
+			++droplet.pathLength;
+
 			// Calculate the height of all the neighbouring cells around the new droplet position
-			const float newHeightXY{ heights.GetHeight(newGridPosX, newGridPosY) };
-			const float newHeightXPlusY{ heights.GetHeight(newGridPosX + 1, newGridPosY) };
-			const float newHeightXYPlus{ heights.GetHeight(newGridPosX, newGridPosY + 1) };
-			const float newHeightXPlusYPlus{ heights.GetHeight(newGridPosX + 1, newGridPosY + 1) };
+			const float newHeightXY{ tile.GetHeight(newGridPosX, newGridPosY) };
+			const float newHeightXPlusY{ tile.GetHeight(newGridPosX + 1, newGridPosY) };
+			const float newHeightXYPlus{ tile.GetHeight(newGridPosX, newGridPosY + 1) };
+			const float newHeightXPlusYPlus{ tile.GetHeight(newGridPosX + 1, newGridPosY + 1) };
 
 			// Calculate the height at the new droplet position
 			const float newHeight{ (1.0f - newCellPosY) * ((1.0f - newCellPosX) * newHeightXY + newCellPosX * newHeightXPlusY) + newCellPosY * ((1.0f - newCellPosX) * newHeightXYPlus + newCellPosX * newHeightXPlusYPlus) };
@@ -97,12 +284,9 @@ void Erosion::HansBeyer::GetHeights(Heightmap& heights)
 				// Calculate the dropped amount of sediment
 				const float droppedSediment{ heightDiff > 0.0f ? std::min(heightDiff, droplet.amountSediment) : (droplet.amountSediment - curCapacity) * m_Deposition };
 
-				// Add the sediment at the four grid positions around the droplets position
-				heights.GetHeight(gridPosX, gridPosY) += droppedSediment * (1.0f - cellPosX) * (1.0f - cellPosY);
-				heights.GetHeight(gridPosX + 1, gridPosY) += droppedSediment * cellPosX * (1.0f - cellPosY);
-				heights.GetHeight(gridPosX, gridPosY + 1) += droppedSediment * (1.0f - cellPosX) * cellPosY;
-				heights.GetHeight(gridPosX + 1, gridPosY + 1) += droppedSediment * cellPosX * cellPosY;
-				
+				DepositSediment(tile, gridPosX, gridPosY, cellPosX, cellPosY, droppedSediment);
+				counters.depositedSediment += droppedSediment;
+
 				// Update the droplets sediment amount
 				droplet.amountSediment -= droppedSediment;
 			}
@@ -111,60 +295,8 @@ void Erosion::HansBeyer::GetHeights(Heightmap& heights)
 				// Calculate the taken amount of sediment
 				const float takenSediment{ std::min((curCapacity - droplet.amountSediment) * m_Erosion, -heightDiff) };
 
-				// Calculate the current position of the droplet
-				const float dropletPosX{ gridPosX + cellPosX };
-				const float dropletPosY{ gridPosY + cellPosY };
-
-				float totalWeight{};
-				float smallestDistance{ FLT_MAX };
-				float highestDistance{};
-
-				// Calculate the weights of all the grid points near the droplet and their combined total weight
-				const int halfErosionRadius{ m_ErosionRadius / 2 };
-				for (int radX{}; radX < m_ErosionRadius; ++radX)
-				{
-					for (int radY{}; radY < m_ErosionRadius; ++radY)
-					{
-						const int xPos = gridPosX + radX - halfErosionRadius;
-						const int yPos = gridPosY + radY - halfErosionRadius;
-
-						const float dX{ dropletPosX - xPos };
-						const float dY{ dropletPosY - yPos };
-
-						const float distance{ sqrtf(static_cast<float>(dX * dX + dY * dY)) };
-						const int radiusIdx{ radX + radY * m_ErosionRadius };
-						radiusWeights[radiusIdx] = distance;
-
-						if (smallestDistance > distance) smallestDistance = distance;
-						if (highestDistance < distance) highestDistance = distance;
-					}
-				}
-
-				// Reverse the weights
-				for (float& weight : radiusWeights)
-				{
-					weight = 1.0f - (weight - smallestDistance) / (highestDistance - smallestDistance);
-					totalWeight += weight;
-				}
-
-				// Normalize the weights
-				for (float& weight : radiusWeights)
-				{
-					weight /= totalWeight;
-				}
-
-				// Remove the sediment from all the grid positions in the radius of the droplet
-				for (int radX{}; radX < m_ErosionRadius; ++radX)
-				{
-					for (int radY{}; radY < m_ErosionRadius; ++radY)
-					{
-						const int xPos = radX - halfErosionRadius;
-						const int yPos = radY - halfErosionRadius;
-
-						const int radiusIdx{ radX + radY * m_ErosionRadius };
-						heights.GetHeight(gridPosX + xPos, gridPosY + yPos) -= takenSediment * radiusWeights[radiusIdx];
-					}
-				}
+				ErodeSediment<Radius>(tile, gridPosX, gridPosY, cellPosX, cellPosY, takenSediment, radiusWeights);
+				counters.erodedSediment += takenSediment;
 
 				// Update the droplets sediment amount
 				droplet.amountSediment += takenSediment;
@@ -175,19 +307,495 @@ void Erosion::HansBeyer::GetHeights(Heightmap& heights)
 			droplet.speed = sqrtSpeed < 0.0f ? 0.0f : sqrtf(sqrtSpeed);
 
 			// If the droplet has lost all its speed, disable the droplet
-			if (droplet.speed <= 0) break;
+			if (droplet.speed <= 0)
+			{
+				pStopReason = &counters.nrStoppedBySpeed;
+				break;
+			}
 
 			// Update the water amount of the droplet
 			droplet.amountWater = droplet.amountWater * (1.0f - m_Evaporation);
 
 			// If the droplet has no more water, disable the droplet
-			if (droplet.amountWater <= 0) break;
+			if (droplet.amountWater <= 0)
+			{
+				pStopReason = &counters.nrStoppedByWater;
+				break;
+			}
 
-			// Increase the life time of the droplet, if it exceeds the max, disable the droplet
-			if (++droplet.pathLength >= m_MaxPathLength) break;
+			// If the life time of the droplet exceeds the max, disable the droplet
+			if (droplet.pathLength >= m_MaxPathLength) break;
 		}
+
+		// The sediment that is still carried by the droplet is lost
+		++*pStopReason;
+		counters.lostSediment += droplet.amountSediment;
+		counters.totalPathLength += droplet.pathLength;
 	}
 
+	return counters;
+}
+
+template<int Radius>
+Erosion::ErosionCounters Erosion::HansBeyer::SimulateDropletBatches(HeightTile& tile, int terrainSize, const ErosionJob& job, const CounterRandom& random, int nrDroplets) const
+{
+	const int firstDropletIdx{ job.statistics.nrDroplets };
+
+	// Every droplet of the batch is stored in its own lane, so each step of the simulation runs over all the lanes at once
+	//	A lane whose droplet is disabled gets a new droplet until all cycles are spawned
+	struct DropletBatch final
+	{
+		std::array<float, m_BatchSize> positionX{};
+		std::array<float, m_BatchSize> positionY{};
+		std::array<float, m_BatchSize> directionX{};
+		std::array<float, m_BatchSize> directionY{};
+		std::array<float, m_BatchSize> speed{};
+		std::array<float, m_BatchSize> amountWater{};
+		std::array<float, m_BatchSize> amountSediment{};
+		std::array<int, m_BatchSize> pathLength{};
+		std::array<int, m_BatchSize> isAlive{};
+	};
+
+	// The values of a single step, shared between the stages of the step
+	struct BatchStep final
+	{
+		std::array<int, m_BatchSize> gridPosX{};
+		std::array<int, m_BatchSize> gridPosY{};
+		std::array<float, m_BatchSize> cellPosX{};
+		std::array<float, m_BatchSize> cellPosY{};
+		std::array<float, m_BatchSize> height{};
+		std::array<float, m_BatchSize> heightDiff{};
+		std::array<float, m_BatchSize> sedimentChange{};
+		std::array<int, m_BatchSize> isDepositing{};
+	};
+
+	DropletBatch droplets{};
+	BatchStep step{};
+
+	// Erosion radius data
+	BrushWeights<Radius> radiusWeights{};
+	if constexpr (Radius == 0) radiusWeights.resize(m_ErosionRadius * m_ErosionRadius);
+
+	const float* pHeights{ tile.GetData() };
+
+	ErosionCounters counters{};
+	int nrSpawnedDroplets{};
+	const auto refillLanes{ [&]()
+		{
+			// Lanes are refilled in order, so the droplets of a batch are always spawned in the same order
+			for (int lane{}; lane < m_BatchSize && nrSpawnedDroplets < nrDroplets; ++lane)
+			{
+				if (droplets.isAlive[lane]) continue;
+
+				SpawnDroplet(terrainSize, job, random, firstDropletIdx + nrSpawnedDroplets, droplets.positionX[lane], droplets.positionY[lane], droplets.directionX[lane], droplets.directionY[lane]);
+				droplets.speed[lane] = 1.0f;
+				droplets.amountWater[lane] = 1.0f;
+				droplets.amountSediment[lane] = 0.0f;
+				droplets.pathLength[lane] = 0;
+				droplets.isAlive[lane] = true;
+
+				++nrSpawnedDroplets;
+			}
+		} };
+
+	// Returns the height at a position, using the heights of the four grid points around it
+	const auto sampleHeight{ [&tile, pHeights](int gridPosX, int gridPosY, float cellPosX, float cellPosY)
+		{
+			const int index{ tile.GetIndex(gridPosX, gridPosY) };
+			const int rowSize{ tile.GetSizeX() };
+
+			const float heightXY{ pHeights[index] };
+			const float heightXPlusY{ pHeights[index + 1] };
+			const float heightXYPlus{ pHeights[index + rowSize] };
+			const float heightXPlusYPlus{ pHeights[index + rowSize + 1] };
+
+			return (1.0f - cellPosY) * ((1.0f - cellPosX) * heightXY + cellPosX * heightXPlusY) + cellPosY * ((1.0f - cellPosX) * heightXYPlus + cellPosX * heightXPlusYPlus);
+		} };
+
+	refillLanes();
+
+	// A slice with fewer droplets than lanes leaves the last lanes empty, they start at the position of the first droplet
+	//	Otherwise they would be sampled at the origin of the world, which can lie outside the tile
+	for (int lane{ nrSpawnedDroplets }; lane < m_BatchSize && nrSpawnedDroplets > 0; ++lane)
+	{
+		droplets.positionX[lane] = droplets.positionX[0];
+		droplets.positionY[lane] = droplets.positionY[0];
+	}
+
+	while (std::any_of(begin(droplets.isAlive), end(droplets.isAlive), [](int isAlive) { return isAlive; }))
+	{
+		// Move every droplet one step along the slope
+		//	Disabled and empty lanes are calculated as well, but keep a position inside the tile so they never read outside of it
+		for (int lane{}; lane < m_BatchSize; ++lane)
+		{
+			// Calculate grid position and position inside cell
+			const int gridPosX{ static_cast<int>(droplets.positionX[lane]) };
+			const int gridPosY{ static_cast<int>(droplets.positionY[lane]) };
+			const float cellPosX{ droplets.positionX[lane] - gridPosX };
+			const float cellPosY{ droplets.positionY[lane] - gridPosY };
+
+			// Calculate the height of all the neighbouring cells around the droplet position
+			const int index{ tile.GetIndex(gridPosX, gridPosY) };
+			const int rowSize{ tile.GetSizeX() };
+			const float heightXY{ pHeights[index] };
+			const float heightXPlusY{ pHeights[index + 1] };
+			const float heightXYPlus{ pHeights[index + rowSize] };
+			const float heightXPlusYPlus{ pHeights[index + rowSize + 1] };
+
+			// Calculate the gradient at the droplet position
+			const float gradientX{ (heightXPlusY - heightXY) * (1.0f - cellPosY) + (heightXPlusYPlus - heightXYPlus) * cellPosY };
+			const float gradientY{ (heightXYPlus - heightXY) * (1.0f - cellPosX) + (heightXPlusYPlus - heightXPlusY) * cellPosX };
+
+			// Calculate the new direction of the droplet
+			const float directionX{ droplets.directionX[lane] * m_Inertia - gradientX * (1.0f - m_Inertia) };
+			const float directionY{ droplets.directionY[lane] * m_Inertia - gradientY * (1.0f - m_Inertia) };
+			const float sqrLength{ directionX * directionX + directionY * directionY };
+			const bool canMove{ sqrLength >= FLT_EPSILON };
+			const float inverseLength{ canMove ? 1.0f / sqrtf(sqrLength) : 0.0f };
+
+			// Calculate the new position of the droplet, a droplet that leaves the tile is disabled
+			const float newPositionX{ droplets.positionX[lane] + directionX * inverseLength };
+			const float newPositionY{ droplets.positionY[lane] + directionY * inverseLength };
+			const bool isInside{ tile.Contains(static_cast<int>(newPositionX), static_cast<int>(newPositionY), m_ErosionRadius) };
+			const bool isMoving{ droplets.isAlive[lane] && canMove && isInside };
+
+			// Count the droplets that stop in this stage, together with the sediment they still carry
+			const bool isStopping{ droplets.isAlive[lane] && !isMoving };
+			counters.nrStoppedByFlatGradient += static_cast<int>(isStopping && !canMove);
+			counters.nrLeftTile += static_cast<int>(isStopping && canMove);
+			counters.lostSediment += isStopping ? droplets.amountSediment[lane] : 0.0f;
+			counters.totalPathLength += isStopping ? droplets.pathLength[lane] : 0;
+
+			droplets.isAlive[lane] = isMoving;
+			droplets.directionX[lane] = directionX * inverseLength;
+			droplets.directionY[lane] = directionY * inverseLength;
+			droplets.positionX[lane] = isMoving ? newPositionX : droplets.positionX[lane];
+			droplets.positionY[lane] = isMoving ? newPositionY : droplets.positionY[lane];
+
+			step.gridPosX[lane] = gridPosX;
+			step.gridPosY[lane] = gridPosY;
+			step.cellPosX[lane] = cellPosX;
+			step.cellPosY[lane] = cellPosY;
+			step.height[lane] = (1.0f - cellPosY) * ((1.0f - cellPosX) * heightXY + cellPosX * heightXPlusY) + cellPosY * ((1.0f - cellPosX) * heightXYPlus + cellPosX * heightXPlusYPlus);
+		}
+
+		// Calculate how much sediment every droplet drops or takes
+		for (int lane{}; lane < m_BatchSize; ++lane)
+		{
+			// Calculate the height at the new droplet position
+			const int newGridPosX{ static_cast<int>(droplets.positionX[lane]) };
+			const int newGridPosY{ static_cast<int>(droplets.positionY[lane]) };
+			const float newCellPosX{ droplets.positionX[lane] - newGridPosX };
+			const float newCellPosY{ droplets.positionY[lane] - newGridPosY };
+			const float newHeight{ sampleHeight(newGridPosX, newGridPosY, newCellPosX, newCellPosY) };
+
+			// Calculate the height difference between the start and end position of the droplet
+			const float heightDiff{ newHeight - step.height[lane] };
+
+			// Calculate the capacity of the droplet at its current state
+			const float curCapacity{ std::max(-heightDiff, m_MinSlope) * droplets.speed[lane] * droplets.amountWater[lane] * m_Capacity };
+			const float amountSediment{ droplets.amountSediment[lane] };
+
+			// If the droplet has more sediment then its capacity, or the droplet is moving upwards, drop sediment on the ground
+			// Otherwise let the droplet take up sediment from the ground
+			const bool isDepositing{ amountSediment > curCapacity || heightDiff > 0.0f };
+			const float droppedSediment{ heightDiff > 0.0f ? std::min(heightDiff, amountSediment) : (amountSediment - curCapacity) * m_Deposition };
+			const float takenSediment{ std::min((curCapacity - amountSediment) * m_Erosion, -heightDiff) };
+
+			step.heightDiff[lane] = heightDiff;
+			step.isDepositing[lane] = isDepositing;
+			step.sedimentChange[lane] = isDepositing ? droppedSediment : takenSediment;
+		}
+
+		// Change the terrain one lane after another, so droplets that touch the same grid points are always resolved in lane order
+		for (int lane{}; lane < m_BatchSize; ++lane)
+		{
+			if (!droplets.isAlive[lane]) continue;
+
+			if (step.isDepositing[lane])
+			{
+				DepositSediment(tile, step.gridPosX[lane], step.gridPosY[lane], step.cellPosX[lane], step.cellPosY[lane], step.sedimentChange[lane]);
+			}
+			else
+			{
+				ErodeSediment<Radius>(tile, step.gridPosX[lane], step.gridPosY[lane], step.cellPosX[lane], step.cellPosY[lane], step.sedimentChange[lane], radiusWeights);
+			}
+
+			(step.isDepositing[lane] ? counters.depositedSediment : counters.erodedSediment) += step.sedimentChange[lane];
+		}
+
+		// Update the state of every droplet and disable the droplets that stopped
+		for (int lane{}; lane < m_BatchSize; ++lane)
+		{
+			// Update the droplets sediment amount
+			droplets.amountSediment[lane] += step.isDepositing[lane] ? -step.sedimentChange[lane] : step.sedimentChange[lane];
+
+			// Update the speed of the droplet
+			const float sqrtSpeed{ droplets.speed[lane] * droplets.speed[lane] + step.heightDiff[lane] * m_Gravity };
+			droplets.speed[lane] = sqrtSpeed < 0.0f ? 0.0f : sqrtf(sqrtSpeed);
+
+			// Update the water amount of the droplet
+			droplets.amountWater[lane] = droplets.amountWater[lane] * (1.0f - m_Evaporation);
+
+			// Increase the life time of the droplet
+			++droplets.pathLength[lane];
+
+			// Disable the droplets without speed, without water or at the end of their life time
+			const bool hasSpeed{ droplets.speed[lane] > 0 };
+			const bool hasWater{ droplets.amountWater[lane] > 0 };
+			const bool isAlive{ hasSpeed && hasWater && droplets.pathLength[lane] < m_MaxPathLength };
+
+			// Count the droplets that stop in this stage, in the same order as the droplets are checked one by one
+			const bool isStopping{ droplets.isAlive[lane] && !isAlive };
+			counters.nrStoppedBySpeed += static_cast<int>(isStopping && !hasSpeed);
+			counters.nrStoppedByWater += static_cast<int>(isStopping && hasSpeed && !hasWater);
+			counters.nrStoppedByPathLength += static_cast<int>(isStopping && hasSpeed && hasWater);
+			counters.lostSediment += isStopping ? droplets.amountSediment[lane] : 0.0f;
+			counters.totalPathLength += isStopping ? droplets.pathLength[lane] : 0;
+
+			droplets.isAlive[lane] = droplets.isAlive[lane] && isAlive;
+		}
+
+		refillLanes();
+	}
+
+	return counters;
+}
+
+void Erosion::HansBeyer::SpawnDroplet(int terrainSize, const ErosionJob& job, const CounterRandom& random, int dropletIdx, float& positionX, float& positionY, float& directionX, float& directionY) const
+{
+	const std::vector<float>& spawnWeights{ job.spawnWeights };
+
+	// Every droplet has its own random numbers, one for each value that is picked at random
+	const auto random01{ [&random, dropletIdx](unsigned int valueIdx) { return random.GetFloat01(static_cast<unsigned int>(dropletIdx), valueIdx); } };
+
+	const float angle{ random01(0) * glm::pi<float>() };
+
+	if (spawnWeights.empty())
+	{
+		// Spawn the droplet at a random position inside the chunk
+		positionX = terrainSize / 2 + job.chunkX * (terrainSize - 1) + random01(1) * (terrainSize - 1);
+		positionY = terrainSize / 2 + job.chunkY * (terrainSize - 1) + random01(2) * (terrainSize - 1);
+	}
+	else
+	{
+		// Pick a block with a chance relative to its weight, the weights are stored as a running total
+		const float weight{ random01(3) * spawnWeights.back() };
+		const int nrWeights{ static_cast<int>(spawnWeights.size()) };
+		const int blockIdx{ std::min(static_cast<int>(std::upper_bound(begin(spawnWeights), end(spawnWeights), weight) - begin(spawnWeights)), nrWeights - 1) };
+
+		// Spawn the droplet at a random position inside the block
+		const int nrBlocks{ (terrainSize - 2) / m_SpawnBlockSize + 1 };
+		const int blockX{ blockIdx % nrBlocks * m_SpawnBlockSize };
+		const int blockY{ blockIdx / nrBlocks * m_SpawnBlockSize };
+		const int blockSizeX{ std::min(m_SpawnBlockSize, terrainSize - 1 - blockX) };
+		const int blockSizeY{ std::min(m_SpawnBlockSize, terrainSize - 1 - blockY) };
+
+		positionX = terrainSize / 2 + job.chunkX * (terrainSize - 1) + blockX + random01(1) * blockSizeX;
+		positionY = terrainSize / 2 + job.chunkY * (terrainSize - 1) + blockY + random01(2) * blockSizeY;
+	}
+
+	// Give the droplet a random direction
+	directionX = cosf(angle);
+	directionY = sinf(angle);
+}
+
+std::vector<float> Erosion::HansBeyer::CalculateSpawnWeights(const HeightTile& tile, int terrainSize, int chunkX, int chunkY) const
+{
+	const int chunkOriginX{ terrainSize / 2 + chunkX * (terrainSize - 1) };
+	const int chunkOriginY{ terrainSize / 2 + chunkY * (terrainSize - 1) };
+	const int nrBlocks{ (terrainSize - 2) / m_SpawnBlockSize + 1 };
+
+	// Calculate the relief (the difference between the highest and lowest point) of every block inside the chunk
+	std::vector<float> spawnWeights(nrBlocks * nrBlocks);
+	float totalRelief{};
+
+	for (int blockIdx{}; blockIdx < nrBlocks * nrBlocks; ++blockIdx)
+	{
+		const int blockX{ blockIdx % nrBlocks * m_SpawnBlockSize };
+		const int blockY{ blockIdx / nrBlocks * m_SpawnBlockSize };
+		const int blockEndX{ std::min(blockX + m_SpawnBlockSize, terrainSize - 1) };
+		const int blockEndY{ std::min(blockY + m_SpawnBlockSize, terrainSize - 1) };
+
+		float lowestHeight{ FLT_MAX };
+		float highestHeight{ -FLT_MAX };
+		for (int y{ blockY }; y <= blockEndY; ++y)
+		{
+			for (int x{ blockX }; x <= blockEndX; ++x)
+			{
+				const float height{ tile.GetHeight(chunkOriginX + x, chunkOriginY + y) };
+				lowestHeight = std::min(lowestHeight, height);
+				highestHeight = std::max(highestHeight, height);
+			}
+		}
+
+		spawnWeights[blockIdx] = highestHeight - lowestHeight;
+		totalRelief += highestHeight - lowestHeight;
+	}
+
+	// A completely flat chunk has no preference, so every droplet spawns anywhere inside the chunk
+	if (totalRelief <= 0.0f) return {};
+
+	// Mix the relief of each block with the average relief, so flat blocks still receive some droplets
+	const float averageRelief{ totalRelief / static_cast<float>(spawnWeights.size()) };
+	for (float& weight : spawnWeights)
+	{
+		weight = (1.0f - m_ReliefBias) * averageRelief + m_ReliefBias * weight;
+	}
+
+	// Mix the share of the relief of each block with its share of the drainage, so more droplets follow the channels
+	if (m_DrainageBias > 0.0f)
+	{
+		const std::vector<float> drainages{ CalculateBlockDrainage(tile, terrainSize, chunkX, chunkY) };
+		const float totalDrainage{ std::accumulate(begin(drainages), end(drainages), 0.0f) };
+		if (totalDrainage > 0.0f)
+		{
+			for (size_t blockIdx{}; blockIdx < spawnWeights.size(); ++blockIdx)
+			{
+				spawnWeights[blockIdx] = (1.0f - m_DrainageBias) * spawnWeights[blockIdx] / totalRelief + m_DrainageBias * drainages[blockIdx] / totalDrainage;
+			}
+		}
+	}
+
+	// The weights are stored as a running total so a block can be picked with a binary search
+	float totalWeight{};
+	for (float& weight : spawnWeights)
+	{
+		totalWeight += weight;
+		weight = totalWeight;
+	}
+
+	return spawnWeights;
+}
+
+std::vector<float> Erosion::HansBeyer::CalculateBlockDrainage(const HeightTile& tile, int terrainSize, int chunkX, int chunkY) const
+{
+	const int chunkOriginX{ terrainSize / 2 + chunkX * (terrainSize - 1) };
+	const int chunkOriginY{ terrainSize / 2 + chunkY * (terrainSize - 1) };
+	const int nrBlocks{ (terrainSize - 2) / m_SpawnBlockSize + 1 };
+
+	// The tile reaches past the chunk, so water from around the chunk flows into the blocks at its edge
+	const FlowMap flow{ tile };
+
+	// Average the logarithm of the accumulation, so a single large river doesn't outweigh every other block
+	std::vector<float> drainages(nrBlocks * nrBlocks);
+	for (int blockIdx{}; blockIdx < nrBlocks * nrBlocks; ++blockIdx)
+	{
+		const int blockX{ blockIdx % nrBlocks * m_SpawnBlockSize };
+		const int blockY{ blockIdx / nrBlocks * m_SpawnBlockSize };
+		const int blockEndX{ std::min(blockX + m_SpawnBlockSize, terrainSize - 1) };
+		const int blockEndY{ std::min(blockY + m_SpawnBlockSize, terrainSize - 1) };
+
+		float totalDrainage{};
+		for (int y{ blockY }; y <= blockEndY; ++y)
+		{
+			for (int x{ blockX }; x <= blockEndX; ++x)
+			{
+				totalDrainage += std::log(static_cast<float>(flow.GetAccumulation(flow.GetIndex(chunkOriginX + x, chunkOriginY + y))));
+			}
+		}
+
+		drainages[blockIdx] = totalDrainage / static_cast<float>((blockEndX - blockX + 1) * (blockEndY - blockY + 1));
+	}
+
+	return drainages;
+}
+
+void Erosion::HansBeyer::DepositSediment(HeightTile& tile, int gridPosX, int gridPosY, float cellPosX, float cellPosY, float amount) const
+{
+	// Add the sediment at the four grid positions around the droplets position
+	tile.GetHeight(gridPosX, gridPosY) += amount * (1.0f - cellPosX) * (1.0f - cellPosY);
+	tile.GetHeight(gridPosX + 1, gridPosY) += amount * cellPosX * (1.0f - cellPosY);
+	tile.GetHeight(gridPosX, gridPosY + 1) += amount * (1.0f - cellPosX) * cellPosY;
+	tile.GetHeight(gridPosX + 1, gridPosY + 1) += amount * cellPosX * cellPosY;
+}
+
+template<int Radius>
+void Erosion::HansBeyer::ErodeSediment(HeightTile& tile, int gridPosX, int gridPosY, float cellPosX, float cellPosY, float amount, BrushWeights<Radius>& radiusWeights) const
+{
+	// With a known radius, the loops below have a fixed length
+	const int erosionRadius{ GetErosionRadius<Radius>() };
+
+	// Calculate the current position of the droplet
+	const float dropletPosX{ gridPosX + cellPosX };
+	const float dropletPosY{ gridPosY + cellPosY };
+
+	float totalWeight{};
+	float smallestDistance{ FLT_MAX };
+	float highestDistance{};
+
+	// Calculate the weights of all the grid points near the droplet and their combined total weight
+	const int halfErosionRadius{ erosionRadius / 2 };
+	for (int radX{}; radX < erosionRadius; ++radX)
+	{
+		for (int radY{}; radY < erosionRadius; ++radY)
+		{
+			const int xPos = gridPosX + radX - halfErosionRadius;
+			const int yPos = gridPosY + radY - halfErosionRadius;
+
+			const float dX{ dropletPosX - xPos };
+			const float dY{ dropletPosY - yPos };
+
+			const float distance{ sqrtf(static_cast<float>(dX * dX + dY * dY)) };
+			const int radiusIdx{ radX + radY * erosionRadius };
+			radiusWeights[radiusIdx] = distance;
+
+			if (smallestDistance > distance) smallestDistance = distance;
+			if (highestDistance < distance) highestDistance = distance;
+		}
+	}
+
+	// Reverse the weights
+	for (float& weight : radiusWeights)
+	{
+		weight = 1.0f - (weight - smallestDistance) / (highestDistance - smallestDistance);
+		totalWeight += weight;
+	}
+
+	// Normalize the weights
+	for (float& weight : radiusWeights)
+	{
+		weight /= totalWeight;
+	}
+
+	// Remove the sediment from all the grid positions in the radius of the droplet
+	for (int radX{}; radX < erosionRadius; ++radX)
+	{
+		for (int radY{}; radY < erosionRadius; ++radY)
+		{
+			const int xPos = radX - halfErosionRadius;
+			const int yPos = radY - halfErosionRadius;
+
+			const int radiusIdx{ radX + radY * erosionRadius };
+			tile.GetHeight(gridPosX + xPos, gridPosY + yPos) -= amount * radiusWeights[radiusIdx];
+		}
+	}
+}
+
+template<int Radius>
+int Erosion::HansBeyer::GetErosionRadius() const
+{
+	if constexpr (Radius > 0) return Radius;
+	else return m_ErosionRadius;
+}
+
+Erosion::HansBeyer::Settings Erosion::HansBeyer::GetSettings() const
+{
+	return Settings{ m_Cycles, m_ErosionRadius, m_MaxPathLength, m_Inertia, m_MinSlope, m_Capacity, m_Gravity, m_Evaporation, m_Deposition, m_Erosion };
+}
+
+void Erosion::HansBeyer::SetSettings(const Settings& settings)
+{
+	m_Cycles = settings.cycles;
+	m_ErosionRadius = settings.erosionRadius;
+	m_MaxPathLength = settings.maxPathLength;
+	m_Inertia = settings.inertia;
+	m_MinSlope = settings.minSlope;
+	m_Capacity = settings.capacity;
+	m_Gravity = settings.gravity;
+	m_Evaporation = settings.evaporation;
+	m_Deposition = settings.deposition;
+	m_Erosion = settings.erosion;
 }
 
 void Erosion::HansBeyer::OnGUI()
@@ -195,6 +803,12 @@ void Erosion::HansBeyer::OnGUI()
 	ImGui::Spacing();
 	ImGui::Text("Hans Beyer Settings");
 	ImGui::SliderInt("Nr Cycles", &m_Cycles, 0, 1'000'000);
+	ImGui::Checkbox("Simulate Droplet Batches", &m_UseDropletBatches);
+	ImGui::Checkbox("Adaptive Cycles", &m_UseAdaptiveCycles);
+	ImGui::SliderInt("Adaptive Batch Size", &m_AdaptiveBatchSize, 100, 50'000);
+	ImGui::SliderFloat("Convergence Threshold", &m_ConvergenceThreshold, 0.0f, 0.01f, "%.5f");
+	ImGui::SliderFloat("Relief Bias", &m_ReliefBias, 0.0f, 1.0f);
+	ImGui::SliderFloat("Drainage Bias", &m_DrainageBias, 0.0f, 1.0f);
 	ImGui::SliderInt("Erosion Radius", &m_ErosionRadius, 1, 30);
 	ImGui::SliderInt("Max Path Length", &m_MaxPathLength, 1, 500);
 	ImGui::SliderFloat("Inertia", &m_Inertia, 0.0f, 1.0f);
@@ -204,4 +818,16 @@ void Erosion::HansBeyer::OnGUI()
 	ImGui::SliderFloat("Evaporation", &m_Evaporation, 0.0f, 1.0f);
 	ImGui::SliderFloat("Deposition", &m_Deposition, 0.0f, 1.0f);
 	ImGui::SliderFloat("Erosion", &m_Erosion, 0.0f, 1.0f);
-}
+
+	ImGui::Spacing();
+	ImGui::Text("Last chunk: %d droplets in %d batches", m_Statistics.nrDroplets, m_Statistics.nrBatches);
+	ImGui::Text("Height change: %.4f (last batch %.4f)%s", m_Statistics.heightChange, m_Statistics.lastBatchChange, m_Statistics.hasConverged ? ", converged" : "");
+
+	// The counters of every chunk since the start
+	const ErosionCounters& counters{ m_TotalCounters };
+	ImGui::Spacing();
+	ImGui::Text("Total droplets: %d, mean path length %.2f", counters.GetNrStoppedDroplets(), counters.GetMeanPathLength());
+	ImGui::Text("Sediment eroded %.4f, deposited %.4f, lost %.4f", counters.erodedSediment, counters.depositedSediment, counters.lostSediment);
+	ImGui::Text("Stopped by speed %d, water %d, path length %d, flat gradient %d, left tile %d",
+		counters.nrStoppedBySpeed, counters.nrStoppedByWater, counters.nrStoppedByPathLength, counters.nrStoppedByFlatGradient, counters.nrLeftTile);
+}
\ No newline at end of file
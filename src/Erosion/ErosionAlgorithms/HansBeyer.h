@@ -1,23 +1,95 @@
 #pragma once
 
 #include "ITerrainGenerator.h"
+#include "../Data/HeightTile.h"
+#include "../Data/CounterRandom.h"
+
+#include <vector>
+#include <array>
+#include <type_traits>
 
 namespace Erosion
 {
 	class HansBeyer final : public ITerrainGenerator
 	{
 	public:
+		// The values that change the shape of the erosion, so they can be tuned without the viewer
+		struct Settings final
+		{
+			int cycles{};
+			int erosionRadius{};
+			int maxPathLength{};
+			float inertia{};
+			float minSlope{};
+			float capacity{};
+			float gravity{};
+			float evaporation{};
+			float deposition{};
+			float erosion{};
+		};
+
 		virtual ~HansBeyer() = default;
 
+		Settings GetSettings() const;
+		void SetSettings(const Settings& settings);
+
 		virtual void SetChunk(int x, int y) override { m_ChunkX = x; m_ChunkY = y; }
 		virtual void GetHeights(Heightmap& heights) override;
-		inline static float Random01() { return static_cast<float>(rand()) / RAND_MAX; }
+		virtual bool Resume(Heightmap& heights, ErosionJob& job, int maxNrDroplets) override;
+		virtual void ResumeParallel(Heightmap& heights, const std::vector<ErosionJob*>& jobs, int maxNrDroplets) override;
 
 		virtual void OnGUI() override;
+		virtual ErosionStatistics GetStatistics() const override { return m_Statistics; }
+		// Returns the counters of every droplet this generator simulated, over all chunks and threads
+		const ErosionCounters& GetTotalCounters() const { return m_TotalCounters; }
 
 	private:
+		HeightTile CreateTile(int chunkX, int chunkY, int terrainSize) const;
+		// Simulates the next droplets of the job on the tile, returns the counters of the simulated droplets
+		//	The seed is the seed of the world, so every world spawns its droplets in other places
+		ErosionCounters ErodeTile(HeightTile& tile, int terrainSize, unsigned int seed, ErosionJob& job, int maxNrDroplets) const;
+
+		// The weights of the erosion brush, radii with their own kernel keep them on the stack
+		template<int Radius>
+		using BrushWeights = std::conditional_t<(Radius > 0), std::array<float, Radius * Radius>, std::vector<float>>;
+
+		// Picks the kernel for the erosion radius, radii without their own kernel use the generic kernel (Radius 0)
+		ErosionCounters Simulate(HeightTile& tile, int terrainSize, const ErosionJob& job, const CounterRandom& random, int nrDroplets) const;
+		template<int Radius>
+		ErosionCounters Simulate(HeightTile& tile, int terrainSize, const ErosionJob& job, const CounterRandom& random, int nrDroplets) const;
+
+		// Both simulations continue after the droplets the job already completed and return what the droplets did
+		//	Droplet i of the chunk always uses the random numbers of counter i, so the droplets can be simulated in any amount of slices
+		template<int Radius>
+		ErosionCounters SimulateDroplets(HeightTile& tile, int terrainSize, const ErosionJob& job, const CounterRandom& random, int nrDroplets) const;
+		template<int Radius>
+		ErosionCounters SimulateDropletBatches(HeightTile& tile, int terrainSize, const ErosionJob& job, const CounterRandom& random, int nrDroplets) const;
+		void SpawnDroplet(int terrainSize, const ErosionJob& job, const CounterRandom& random, int dropletIdx, float& positionX, float& positionY, float& directionX, float& directionY) const;
+		std::vector<float> CalculateSpawnWeights(const HeightTile& tile, int terrainSize, int chunkX, int chunkY) const;
+		// Returns the average of the logarithm of the flow accumulation of every spawn block, blocks with channels drain more water
+		std::vector<float> CalculateBlockDrainage(const HeightTile& tile, int terrainSize, int chunkX, int chunkY) const;
+		void DepositSediment(HeightTile& tile, int gridPosX, int gridPosY, float cellPosX, float cellPosY, float amount) const;
+		template<int Radius>
+		void ErodeSediment(HeightTile& tile, int gridPosX, int gridPosY, float cellPosX, float cellPosY, float amount, BrushWeights<Radius>& radiusWeights) const;
+		template<int Radius>
+		int GetErosionRadius() const;
+
+		// The amount of droplets that are simulated together in batch mode
+		static constexpr int m_BatchSize{ 8 };
+		// The size of the square blocks that share a spawn weight in adaptive mode
+		static constexpr int m_SpawnBlockSize{ 16 };
+
 		// Simulation data
 		int m_Cycles{ /*15106*/75'000 };
+		bool m_UseDropletBatches{};
+
+		// Adaptive simulation data, m_Cycles is the maximum amount of droplets
+		bool m_UseAdaptiveCycles{};
+		int m_AdaptiveBatchSize{ 5'000 };
+		float m_ConvergenceThreshold{ 0.0005f };
+		float m_ReliefBias{ 0.75f };
+		// How much of the spawn weights comes from the drainage of the blocks instead of their relief
+		float m_DrainageBias{};
 
 		// Erosion radius data
 		int m_ErosionRadius{ 6 };
@@ -35,5 +107,8 @@ namespace Erosion
 		// Chunk data
 		int m_ChunkX{};
 		int m_ChunkY{};
+
+		ErosionStatistics m_Statistics{};
+		ErosionCounters m_TotalCounters{};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "HeightFilters.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <cmath>
+
+void Erosion::HeightFilters::BoxBlur(HeightTile& tile, int radius)
+{
+	if (radius <= 0) return;
+
+	BoxBlurRows(tile, radius);
+	BoxBlurColumns(tile, radius);
+}
+
+void Erosion::HeightFilters::GaussianBlur(HeightTile& tile, float sigma)
+{
+	for (const int radius : GetGaussianRadii(sigma))
+	{
+		BoxBlur(tile, radius);
+	}
+}
+
+void Erosion::HeightFilters::EdgeAwareBlur(HeightTile& tile, float spatialSigma, float heightSigma, int nrIterations)
+{
+	if (nrIterations <= 0 || spatialSigma <= 0.0f || heightSigma <= 0.0f) return;
+
+	const int sizeX{ tile.GetSizeX() };
+	const float* pHeights{ tile.GetData() };
+
+	// Calculate the spatial sigma of the first iteration, so the sigmas of all the iterations add up to the spatial sigma
+	const float firstSigma{ spatialSigma * std::sqrt(3.0f) * std::pow(2.0f, static_cast<float>(nrIterations - 1)) / std::sqrt(std::pow(4.0f, static_cast<float>(nrIterations)) - 1.0f) };
+	const float logFeedback{ -std::sqrt(2.0f) / firstSigma };
+	const float distanceScale{ spatialSigma / heightSigma };
+
+	// Calculate how much every cell takes over from the cell before it in its row and in its column
+	//	Steep cells lie further away from the cell before them, so they take over less and the edge stays
+	//	The weights are calculated from the heights before the blur, so every iteration stops at the same edges
+	std::vector<float> rowWeights(sizeX * tile.GetSizeY());
+	std::vector<float> columnWeights(rowWeights.size());
+	ForEachRange(tile.GetSizeY(), m_BandHeight, [&](int firstY, int endY)
+		{
+			for (int y{ firstY }; y < endY; ++y)
+			{
+				for (int x{}; x < sizeX; ++x)
+				{
+					const int cellIdx{ x + y * sizeX };
+					if (x > 0) rowWeights[cellIdx] = std::exp(logFeedback * (1.0f + distanceScale * std::abs(pHeights[cellIdx] - pHeights[cellIdx - 1])));
+					if (y > 0) columnWeights[cellIdx] = std::exp(logFeedback * (1.0f + distanceScale * std::abs(pHeights[cellIdx] - pHeights[cellIdx - sizeX])));
+				}
+			}
+		});
+
+	for (int iterationIdx{}; iterationIdx < nrIterations; ++iterationIdx)
+	{
+		RecursiveFilterRows(tile, rowWeights);
+		RecursiveFilterColumns(tile, columnWeights);
+
+		// The sigma halves every iteration, which squares the weights
+		const auto square{ [](float weight) { return weight * weight; } };
+		std::transform(std::execution::par, begin(rowWeights), end(rowWeights), begin(rowWeights), square);
+		std::transform(std::execution::par, begin(columnWeights), end(columnWeights), begin(columnWeights), square);
+	}
+}
+
+std::vector<int> Erosion::HeightFilters::GetGaussianRadii(float sigma)
+{
+	std::vector<int> radii(m_NrGaussianBoxes);
+	if (sigma <= 0.0f) return radii;
+
+	// Three box blurs with a width of about sqrt(12 * sigma^2 / 3 + 1) have the same variance as the gaussian
+	//	The widths must be odd, so some boxes use the odd width below the ideal width and the others the odd width above it
+	const float nrBoxes{ static_cast<float>(m_NrGaussianBoxes) };
+	const float idealWidth{ std::sqrt(12.0f * sigma * sigma / nrBoxes + 1.0f) };
+	int lowerWidth{ static_cast<int>(idealWidth) };
+	if (lowerWidth % 2 == 0) --lowerWidth;
+	const int upperWidth{ lowerWidth + 2 };
+
+	// Calculate how many boxes use the lower width, so the variance of all the boxes matches the variance of the gaussian
+	const float width{ static_cast<float>(lowerWidth) };
+	const float idealNrLowerBoxes{ (12.0f * sigma * sigma - nrBoxes * width * width - 4.0f * nrBoxes * width - 3.0f * nrBoxes) / (-4.0f * width - 4.0f) };
+	const int nrLowerBoxes{ static_cast<int>(std::round(idealNrLowerBoxes)) };
+
+	for (int boxIdx{}; boxIdx < m_NrGaussianBoxes; ++boxIdx)
+	{
+		radii[boxIdx] = ((boxIdx < nrLowerBoxes ? lowerWidth : upperWidth) - 1) / 2;
+	}
+	return radii;
+}
+
+void Erosion::HeightFilters::BoxBlurRows(HeightTile& tile, int radius)
+{
+	const int sizeX{ tile.GetSizeX() };
+	float* pHeights{ tile.GetData() };
+
+	ForEachRange(tile.GetSizeY(), m_BandHeight, [&](int firstY, int endY)
+		{
+			// The heights in front of a cell are still the original heights, the ring keeps the original heights of the cells behind it that are still inside the window
+			std::vector<float> ring(radius + 1);
+			for (int y{ firstY }; y < endY; ++y)
+			{
+				float* pRow{ pHeights + y * sizeX };
+
+				// Calculate the sum of the window of the first cell
+				float sum{};
+				for (int x{}; x <= std::min(radius, sizeX - 1); ++x)
+				{
+					sum += pRow[x];
+				}
+
+				int ringIdx{};
+				for (int x{}; x < sizeX; ++x)
+				{
+					const int nrWindowCells{ std::min(x + radius, sizeX - 1) - std::max(x - radius, 0) + 1 };
+					ring[ringIdx] = pRow[x];
+					pRow[x] = sum / nrWindowCells;
+
+					// Move the window to the next cell, the oldest height in the ring leaves the window
+					ringIdx = ringIdx == radius ? 0 : ringIdx + 1;
+					if (x + radius + 1 < sizeX) sum += pRow[x + radius + 1];
+					if (x - radius >= 0) sum -= ring[ringIdx];
+				}
+			}
+		});
+}
+
+void Erosion::HeightFilters::BoxBlurColumns(HeightTile& tile, int radius)
+{
+	const int sizeX{ tile.GetSizeX() };
+	const int sizeY{ tile.GetSizeY() };
+	float* pHeights{ tile.GetData() };
+
+	// Every strip of columns moves its windows down one row at a time, so every step is a loop over neighbouring cells
+	ForEachRange(sizeX, m_StripWidth, [&](int firstX, int endX)
+		{
+			const int width{ endX - firstX };
+
+			// The ring keeps the original heights of the rows above the current row that are still inside the window
+			std::vector<float> ring((radius + 1) * width);
+			std::vector<float> sums(width);
+			for (int y{}; y <= std::min(radius, sizeY - 1); ++y)
+			{
+				const float* pRow{ pHeights + y * sizeX + firstX };
+				for (int i{}; i < width; ++i)
+				{
+					sums[i] += pRow[i];
+				}
+			}
+
+			int ringIdx{};
+			for (int y{}; y < sizeY; ++y)
+			{
+				float* pRow{ pHeights + y * sizeX + firstX };
+				float* pRingRow{ ring.data() + ringIdx * width };
+				const float inverseNrWindowCells{ 1.0f / (std::min(y + radius, sizeY - 1) - std::max(y - radius, 0) + 1) };
+				for (int i{}; i < width; ++i)
+				{
+					pRingRow[i] = pRow[i];
+					pRow[i] = sums[i] * inverseNrWindowCells;
+				}
+
+				// Move the windows to the next row, the oldest row in the ring leaves the windows
+				ringIdx = ringIdx == radius ? 0 : ringIdx + 1;
+				if (y + radius + 1 < sizeY)
+				{
+					const float* pAddedRow{ pHeights + (y + radius + 1) * sizeX + firstX };
+					for (int i{}; i < width; ++i)
+					{
+						sums[i] += pAddedRow[i];
+					}
+				}
+				if (y - radius >= 0)
+				{
+					const float* pRemovedRow{ ring.data() + ringIdx * width };
+					for (int i{}; i < width; ++i)
+					{
+						sums[i] -= pRemovedRow[i];
+					}
+				}
+			}
+		});
+}
+
+void Erosion::HeightFilters::RecursiveFilterRows(HeightTile& tile, const std::vector<float>& weights)
+{
+	const int sizeX{ tile.GetSizeX() };
+	float* pHeights{ tile.GetData() };
+
+	ForEachRange(tile.GetSizeY(), m_BandHeight, [&](int firstY, int endY)
+		{
+			for (int y{ firstY }; y < endY; ++y)
+			{
+				float* pRow{ pHeights + y * sizeX };
+				const float* pWeights{ weights.data() + y * sizeX };
+
+				// Run the filter from left to right and back, so both sides of a cell are blurred the same way
+				for (int x{ 1 }; x < sizeX; ++x)
+				{
+					pRow[x] += pWeights[x] * (pRow[x - 1] - pRow[x]);
+				}
+				for (int x{ sizeX - 2 }; x >= 0; --x)
+				{
+					pRow[x] += pWeights[x + 1] * (pRow[x + 1] - pRow[x]);
+				}
+			}
+		});
+}
+
+void Erosion::HeightFilters::RecursiveFilterColumns(HeightTile& tile, const std::vector<float>& weights)
+{
+	const int sizeX{ tile.GetSizeX() };
+	const int sizeY{ tile.GetSizeY() };
+	float* pHeights{ tile.GetData() };
+
+	ForEachRange(sizeX, m_StripWidth, [&](int firstX, int endX)
+		{
+			const int width{ endX - firstX };
+
+			// Run the filter from top to bottom and back, every step handles the whole row of the strip
+			for (int y{ 1 }; y < sizeY; ++y)
+			{
+				float* pRow{ pHeights + y * sizeX + firstX };
+				const float* pPreviousRow{ pRow - sizeX };
+				const float* pWeights{ weights.data() + y * sizeX + firstX };
+				for (int i{}; i < width; ++i)
+				{
+					pRow[i] += pWeights[i] * (pPreviousRow[i] - pRow[i]);
+				}
+			}
+			for (int y{ sizeY - 2 }; y >= 0; --y)
+			{
+				float* pRow{ pHeights + y * sizeX + firstX };
+				const float* pNextRow{ pRow + sizeX };
+				const float* pWeights{ weights.data() + (y + 1) * sizeX + firstX };
+				for (int i{}; i < width; ++i)
+				{
+					pRow[i] += pWeights[i] * (pNextRow[i] - pRow[i]);
+				}
+			}
+		});
+}
+
+template<typename Function>
+void Erosion::HeightFilters::ForEachRange(int nrItems, int rangeSize, const Function& function)
+{
+	const int nrRanges{ (nrItems + rangeSize - 1) / rangeSize };
+	std::vector<int> rangeIndices(nrRanges);
+	std::iota(begin(rangeIndices), end(rangeIndices), 0);
+	std::for_each(std::execution::par, begin(rangeIndices), end(rangeIndices), [&](int rangeIdx)
+		{
+			function(rangeIdx * rangeSize, std::min((rangeIdx + 1) * rangeSize, nrItems));
+		});
+}
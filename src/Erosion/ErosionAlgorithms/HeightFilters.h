@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../Data/HeightTile.h"
+
+#include <vector>
+
+namespace Erosion
+{
+	// Filters that smooth the heights of a tile in place
+	//	Every filter is split in a pass over the rows and a pass over the columns, so the cost per cell doesn't grow with the size of the filter
+	//	The rows are divided over the threads, the column passes handle a strip of neighbouring columns at once so the compiler can use vector instructions
+	class HeightFilters final
+	{
+	public:
+		// Replaces every height by the average of the square of (2 * radius + 1)^2 cells around it, cells outside the tile are left out of the average
+		static void BoxBlur(HeightTile& tile, int radius);
+		// Approximates a gaussian blur with a standard deviation of sigma cells by three box blurs
+		static void GaussianBlur(HeightTile& tile, float sigma);
+		// Smooths the heights like a gaussian blur with a standard deviation of spatialSigma cells, but stops at steep edges
+		//	A height difference of heightSigma between two cells counts as much as spatialSigma cells of distance, so smaller values keep more edges
+		//	Every iteration smooths again with half of the spatial sigma of the iteration before, which removes the stripes a single iteration leaves along the edges
+		static void EdgeAwareBlur(HeightTile& tile, float spatialSigma, float heightSigma, int nrIterations);
+
+		// Returns the radii of the box blurs that approximate a gaussian blur, the sum of the radii is how far the blur reaches
+		static std::vector<int> GetGaussianRadii(float sigma);
+
+	private:
+		static void BoxBlurRows(HeightTile& tile, int radius);
+		static void BoxBlurColumns(HeightTile& tile, int radius);
+		// Runs a recursive filter forwards and backwards over every row or column, the weight of a cell is how much of the previous cell it takes over
+		static void RecursiveFilterRows(HeightTile& tile, const std::vector<float>& weights);
+		static void RecursiveFilterColumns(HeightTile& tile, const std::vector<float>& weights);
+
+		// Divides the items in ranges of rangeSize items and calls the function with the first and end item of every range, the ranges are divided over the threads
+		template<typename Function>
+		static void ForEachRange(int nrItems, int rangeSize, const Function& function);
+
+		// The amount of rows that a thread handles at once
+		static constexpr int m_BandHeight{ 16 };
+		// The amount of columns that a column pass handles at once, every strip keeps its own running sums
+		static constexpr int m_StripWidth{ 64 };
+		// The amount of box blurs that approximate a gaussian blur
+		static constexpr int m_NrGaussianBoxes{ 3 };
+	};
+}
@@ -2,6 +2,8 @@
 
 #include <vector>
 #include "../Data/Heightmap.h"
+#include "../Data/ErosionStatistics.h"
+#include "../Data/ErosionJob.h"
 
 namespace Erosion
 {
@@ -13,5 +15,30 @@ namespace Erosion
 		virtual void SetChunk(int x, int y) = 0;
 		virtual void GetHeights(Heightmap& heights) = 0;
 		virtual void OnGUI() = 0;
+
+		// Continues the erosion of the chunk of the job for at most the given amount of work, returns true when the job is finished
+		//	Generators that can't be split up erode the whole chunk at once
+		virtual bool Resume(Heightmap& heights, ErosionJob& job, int /*maxWork*/)
+		{
+			SetChunk(job.chunkX, job.chunkY);
+			GetHeights(heights);
+			job.statistics = GetStatistics();
+			job.isStarted = true;
+			job.isFinished = true;
+			return true;
+		}
+
+		// Continues several jobs at once, every job starts from the heights before this call and their changes are added together afterwards
+		//	Generators that can't run jobs side by side continue the jobs one after another
+		virtual void ResumeParallel(Heightmap& heights, const std::vector<ErosionJob*>& jobs, int maxWork)
+		{
+			for (ErosionJob* pJob : jobs)
+			{
+				Resume(heights, *pJob, maxWork);
+			}
+		}
+
+		// Returns the statistics of the last chunk this generator created heights for
+		virtual ErosionStatistics GetStatistics() const { return ErosionStatistics{}; }
 	};
 }
\ No newline at end of file
@@ -1,216 +1,224 @@
 #include "RiverLand.h"
+#include "HeightFilters.h"
+#include "FlowMap.h"
 
-#include <queue>
-#include <set>
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <cmath>
 #include <ImGui/imgui.h>
 
-void Erosion::RiverLand::GetHeights(Heightmap& /*heights*/)
+void Erosion::RiverLand::GetHeights(Heightmap& heights)
 {
-	//// Retrieve the terrain size
-	//const int terrainSize{ static_cast<int>(sqrtf(static_cast<float>(heights.size()))) };
-
-	//// Create a grid of cells
-	//std::vector<RiverLandCell> cells(heights.size());
-	//// Create a queue of cells that need to be checked
-	//std::queue<RiverLandCell*> riverCells{};
-
-	//// For each cell
-	//for (int x{}; x < terrainSize; ++x)
-	//{
-	//	for (int z{}; z < terrainSize; ++z)
-	//	{
-	//		// Use the height from the heightmap as a slope
-	//		const float slope{ heights[x + z * terrainSize] };
-
-	//		// Create a cell
-	//		RiverLandCell& cell{ cells[x + z * terrainSize] };
-	//		cell.slope = slope;
-	//		cell.x = x;
-	//		cell.z = z;
-
-	//		// If the cell is below water height, add it to the queue and set the distance from water to 0
-	//		if (heights[x + z * terrainSize] < m_RiverHeight)
-	//		{
-	//			riverCells.push(&cell);
-	//			cell.isChecked = true;
-	//			cell.distance = 0.0f;
-	//		}
-	//	}
-	//}
-
-	//// While there are still cells in the queue
-	//while (!riverCells.empty())
-	//{
-	//	// Pop the first cell from the queue
-	//	RiverLandCell& cell{ *riverCells.front() };
-	//	riverCells.pop();
-
-	//	// For each neighbour
-	//	for (int x{ -1 }; x <= 1; ++x)
-	//	{
-	//		for (int z{ -1 }; z <= 1; ++z)
-	//		{
-	//			// Don't check diagonally or itself
-	//			if (abs(x) == 1 && abs(z) == 1) continue;
-	//			if (x == 0 && z == 0) continue;
-
-	//			// Calculate coordinates of neighbouring cell
-	//			const int otherX{ cell.x + x };
-	//			const int otherZ{ cell.z + z };
-
-	//			// Bounds check on the neighbouring cell
-	//			if (otherX < 0 || otherX >= terrainSize || otherZ < 0 || otherZ >= terrainSize) continue;
-
-	//			// Get the neighbouring cell
-	//			RiverLandCell& other{ cells[otherX + otherZ * terrainSize] };
-
-	//			// Add the neighbour to the queue if it hasn't been added before
-	//			if (!other.isChecked)
-	//			{
-	//				other.isChecked = true;
-	//				riverCells.push(&other);
-	//			}
-
-	//			// Calculate the distance from the cell
-	//			const float distance{ cell.distance + other.slope };
-
-	//			// If the neighbour is further away from a water source via the current cell, discard it
-	//			if (distance > other.distance) continue;
-
-	//			// Set the new distance for the neighbouring cell
-	//			other.distance = distance;
-	//		}
-	//	}
-	//}
-
-	//// Normalize the distance so the farthest distance is 1.0 and set the squared distance as the height of the cell
-	//for (RiverLandCell& cell : cells)
-	//{
-	//	const float normalizedDistance{ cell.distance * cell.slope / m_Divider };
-	//	heights[cell.x + cell.z * terrainSize] = normalizedDistance;
-	//}
-
-	//// Cliff removal
-	//if (m_DoCliffDetection)
-	//{
-	//	std::set<int> cliffCellsUnique{};
-	//	std::queue<int> cliffCells{};
-	//	for (RiverLandCell& cell : cells)
-	//	{
-	//		// Get the idx and height of the current cell
-	//		const int cellIdx{ cell.x + cell.z * terrainSize };
-	//		const float height{ heights[cellIdx] };
-
-	//		// Find the neighbour with the highest point
-	//		float highestPeak{};
-	//		int highestNeighbour{};
-	//		for (int x{ -1 }; x < 1; ++x)
-	//		{
-	//			for (int z{ -1 }; z < 1; ++z)
-	//			{
-	//				if (abs(x) == 1 && abs(z) == 1) continue;
-	//				if (x == 0 && z == 0) continue;
-
-	//				if (cell.x + x < 0 || cell.x + x >= terrainSize) continue;
-	//				if (cell.z + z < 0 || cell.z + z >= terrainSize) continue;
-
-	//				const int neighbourIdx{ cell.x + x + (cell.z + z) * terrainSize };
-	//				const float neighbourHeight{ heights[neighbourIdx] };
-	//				if (highestPeak < neighbourHeight)
-	//				{
-	//					highestPeak = neighbourHeight;
-	//					highestNeighbour = neighbourIdx;
-	//				}
-	//			}
-	//		}
-
-	//		// If none of the neighbours is higher then the cliff threshold, continue to the next cell
-	//		if (highestPeak - height < m_CliffThreshold) continue;
-
-	//		// Add the cell that is higher then the cliff threshold to the queue
-	//		cliffCells.push(cellIdx);
-	//		cliffCellsUnique.insert(cellIdx);
-
-	//		// Set the height of the current cell so it is inside the cliff threshold from its highest neighbour
-	//		heights[cellIdx] = highestPeak - m_CliffThreshold;
-	//	}
-
-	//	// While there are still cells that form a cliff
-	//	while (!cliffCells.empty())
-	//	{
-	//		// Get the first cell idx in the queue
-	//		int cellIdx{ cliffCells.front() };
-	//		cliffCells.pop();
-	//		cliffCellsUnique.erase(cellIdx);
-
-	//		// Get the current cell
-	//		const RiverLandCell& cell{ cells[cellIdx] };
-
-	//		// For each neighbour
-	//		for (int x{ -1 }; x < 1; ++x)
-	//		{
-	//			for (int z{ -1 }; z < 1; ++z)
-	//			{
-	//				// Discard diagonal neighbours and itself
-	//				if (abs(x) == 1 && abs(z) == 1) continue;
-	//				if (x == 0 && z == 0) continue;
-
-	//				// Bounds check on the neighbour coordinates
-	//				if (cell.x + x < 0 || cell.x + x >= terrainSize) continue;
-	//				if (cell.z + z < 0 || cell.z + z >= terrainSize) continue;
-
-	//				const int neighbourIdx{ cell.x + x + (cell.z + z) * terrainSize };
-
-	//				// If the neighbour is within cliff threshold, continue to the next neighbour
-	//				if (heights[neighbourIdx] > heights[cellIdx] - m_CliffThreshold) continue;
-
-	//				// Add the neighbour to the queue if it isn't already added
-	//				if (!cliffCellsUnique.contains(neighbourIdx))
-	//				{
-	//					cliffCells.push(neighbourIdx);
-	//					cliffCellsUnique.insert(neighbourIdx);
-	//				}
-
-	//				// Move the neighbour so it is within the cliff threshold of the current cell
-	//				heights[neighbourIdx] = heights[cellIdx] - m_CliffThreshold;
-	//			}
-	//		}
-	//	}
-	//}
-
-	//// Blur the heightmap
-	//const float kernel{ 1.0f / (m_BlurSize * m_BlurSize) };
-	//std::vector<float> blurredHeights(heights.size());
-	//for (int x{}; x < terrainSize; ++x)
-	//{
-	//	for (int z{}; z < terrainSize; ++z)
-	//	{
-	//		float sum{};
-	//		for (int k{}; k < m_BlurSize; ++k)
-	//		{
-	//			for (int l{}; l < m_BlurSize; ++l)
-	//			{
-	//				int row{ x + k - m_BlurSize / 2 };
-	//				int col{ z + l - m_BlurSize / 2 };
-
-	//				if (row < 0 || row >= terrainSize || col < 0 || col >= terrainSize) continue;
-
-	//				sum += heights[row + col * terrainSize] * kernel;
-	//			}
-	//		}
-	//		blurredHeights[x + z * terrainSize] = sum;
-	//	}
-	//}
-	//heights = std::move(blurredHeights);
+	// Terrain data
+	const int terrainSize{ heights.GetSize() };
+	const int chunkOriginX{ terrainSize / 2 + m_ChunkX * (terrainSize - 1) };
+	const int chunkOriginY{ terrainSize / 2 + m_ChunkY * (terrainSize - 1) };
+
+	// The tile holds the chunk and the halo around it, so rivers just outside the chunk are found as well
+	const int tileSize{ terrainSize + 2 * m_HaloSize };
+	HeightTile tile{ chunkOriginX - m_HaloSize, chunkOriginY - m_HaloSize, tileSize, tileSize };
+	tile.Load(heights);
+
+	// Scale the distance to the closest river by the height of the cell
+	const std::vector<uint32_t> distances{ CalculateDistances(tile, FindRivers(tile)) };
+	float* pHeights{ tile.GetData() };
+	for (size_t cellIdx{}; cellIdx < distances.size(); ++cellIdx)
+	{
+		// Cells without a river inside the tile keep their height
+		if (distances[cellIdx] == UINT32_MAX) continue;
+
+		const float distance{ static_cast<float>(distances[cellIdx]) / m_StepsPerHeight };
+		pHeights[cellIdx] = distance * pHeights[cellIdx] / m_Divider;
+	}
+
+	// Cliff removal
+	if (m_DoCliffDetection) RemoveCliffs(tile);
+
+	// Blur the heightmap, the window of an even blur size is one cell larger than the blur size
+	HeightFilters::BoxBlur(tile, m_BlurSize / 2);
+
+	// Only the chunk is written, the halo was only needed to look around the chunk
+	HeightTile chunk{ chunkOriginX, chunkOriginY, terrainSize, terrainSize };
+	for (int y{ chunkOriginY }; y < chunkOriginY + terrainSize; ++y)
+	{
+		std::copy_n(tile.GetData() + tile.GetIndex(chunkOriginX, y), terrainSize, chunk.GetData() + chunk.GetIndex(chunkOriginX, y));
+	}
+	chunk.Store(heights);
+}
+
+std::vector<uint8_t> Erosion::RiverLand::FindRivers(const HeightTile& tile) const
+{
+	std::vector<uint8_t> isRiver(tile.GetSizeX() * tile.GetSizeY());
+
+	if (m_UseDrainage)
+	{
+		// The water of the halo drains into the chunk as well, so rivers that start outside the chunk are found
+		const FlowMap flow{ tile };
+		const std::vector<int>& accumulations{ flow.GetAccumulations() };
+		std::transform(begin(accumulations), end(accumulations), begin(isRiver), [this](int accumulation) { return static_cast<uint8_t>(accumulation >= m_RiverAccumulation); });
+	}
+	else
+	{
+		const float* pHeights{ tile.GetData() };
+		std::transform(pHeights, pHeights + isRiver.size(), begin(isRiver), [this](float height) { return static_cast<uint8_t>(height < m_RiverHeight); });
+	}
+
+	return isRiver;
+}
+
+std::vector<uint32_t> Erosion::RiverLand::CalculateDistances(const HeightTile& tile, const std::vector<uint8_t>& isRiver) const
+{
+	const int sizeX{ tile.GetSizeX() };
+	const int sizeY{ tile.GetSizeY() };
+	const float* pHeights{ tile.GetData() };
+
+	// Stepping onto a cell costs the height of that cell, rounded to whole steps
+	const auto getStepCost{ [](float height) { return static_cast<uint32_t>(std::clamp(height, 0.0f, 1.0f) * m_StepsPerHeight + 0.5f); } };
+
+	// A cell can be at most one step cost further than the cell it is reached from
+	//	So a circular array of buckets, one per possible distance ahead of the current distance, holds every queued cell in order
+	std::vector<uint32_t> distances(sizeX * sizeY, UINT32_MAX);
+	std::vector<std::vector<int>> buckets(m_StepsPerHeight + 1);
+	size_t nrQueuedCells{};
+
+	// Every river cell has no distance from water
+	for (int cellIdx{}; cellIdx < sizeX * sizeY; ++cellIdx)
+	{
+		if (!isRiver[cellIdx]) continue;
+
+		distances[cellIdx] = 0;
+		buckets[0].push_back(cellIdx);
+		++nrQueuedCells;
+	}
+
+	// Handle the buckets in order of distance until every queued cell is handled
+	for (uint32_t distance{}; nrQueuedCells > 0; ++distance)
+	{
+		// Cells that cost nothing to step on are added to the bucket that is being handled, so the bucket is read by index
+		std::vector<int>& bucket{ buckets[distance % buckets.size()] };
+		for (size_t entryIdx{}; entryIdx < bucket.size(); ++entryIdx)
+		{
+			const int cellIdx{ bucket[entryIdx] };
+			--nrQueuedCells;
+
+			// A cell is queued again every time its distance gets shorter, only the entry with the shortest distance is handled
+			if (distances[cellIdx] != distance) continue;
+
+			const int x{ cellIdx % sizeX };
+			const int y{ cellIdx / sizeX };
+
+			// For each neighbour, diagonal neighbours are not checked
+			constexpr int nrNeighbours{ 4 };
+			constexpr int offsetsX[nrNeighbours]{ -1, 1, 0, 0 };
+			constexpr int offsetsY[nrNeighbours]{ 0, 0, -1, 1 };
+			for (int neighbourIdx{}; neighbourIdx < nrNeighbours; ++neighbourIdx)
+			{
+				// Bounds check on the neighbouring cell
+				const int otherX{ x + offsetsX[neighbourIdx] };
+				const int otherY{ y + offsetsY[neighbourIdx] };
+				if (otherX < 0 || otherX >= sizeX || otherY < 0 || otherY >= sizeY) continue;
+
+				// If the neighbour is closer to a water source along another path, discard it
+				const int otherIdx{ otherX + otherY * sizeX };
+				const uint32_t otherDistance{ distance + getStepCost(pHeights[otherIdx]) };
+				if (otherDistance >= distances[otherIdx]) continue;
+
+				// Set the new distance for the neighbouring cell and queue it with that distance
+				distances[otherIdx] = otherDistance;
+				buckets[otherDistance % buckets.size()].push_back(otherIdx);
+				++nrQueuedCells;
+			}
+		}
+		bucket.clear();
+	}
+
+	return distances;
+}
+
+void Erosion::RiverLand::RemoveCliffs(HeightTile& tile) const
+{
+	const int sizeX{ tile.GetSizeX() };
+	const int sizeY{ tile.GetSizeY() };
+	float* pHeights{ tile.GetData() };
+
+	// Returns the height of the cell when it lies within the cliff threshold of every neighbour
+	//	Cells are only ever raised to the height of a neighbour minus the threshold, so the lowest heights without cliffs are found no matter in which order the cells are handled
+	const auto relax{ [&](int cellIdx)
+		{
+			const int x{ cellIdx % sizeX };
+			const int y{ cellIdx / sizeX };
+
+			float height{ pHeights[cellIdx] };
+			if (x > 0) height = std::max(height, pHeights[cellIdx - 1] - m_CliffThreshold);
+			if (x + 1 < sizeX) height = std::max(height, pHeights[cellIdx + 1] - m_CliffThreshold);
+			if (y > 0) height = std::max(height, pHeights[cellIdx - sizeX] - m_CliffThreshold);
+			if (y + 1 < sizeY) height = std::max(height, pHeights[cellIdx + sizeX] - m_CliffThreshold);
+			return height;
+		} };
+
+	// Every cell is checked once, after that only the neighbours of the cells that were raised in the round before
+	std::vector<int> candidates(sizeX * sizeY);
+	std::iota(begin(candidates), end(candidates), 0);
+	std::vector<float> candidateHeights{};
+	std::vector<int> frontier{};
+
+	// A bit per cell marks the cells that are already a candidate, so a cell next to several raised cells is only checked once
+	std::vector<uint64_t> isCandidate((candidates.size() + 63) / 64);
+
+	while (!candidates.empty())
+	{
+		// Every candidate only reads the heights of the previous round and writes its own entry, so the candidates can be relaxed in parallel
+		candidateHeights.resize(candidates.size());
+		std::transform(std::execution::par, begin(candidates), end(candidates), begin(candidateHeights), relax);
+
+		// Raise the candidates once every candidate is relaxed, the raised cells form the frontier of the next round
+		frontier.clear();
+		for (size_t candidateIdx{}; candidateIdx < candidates.size(); ++candidateIdx)
+		{
+			const int cellIdx{ candidates[candidateIdx] };
+			if (candidateHeights[candidateIdx] <= pHeights[cellIdx]) continue;
+
+			pHeights[cellIdx] = candidateHeights[candidateIdx];
+			frontier.push_back(cellIdx);
+		}
+
+		// The neighbours of the frontier are the candidates of the next round
+		candidates.clear();
+		const auto addCandidate{ [&](int cellIdx)
+			{
+				uint64_t& word{ isCandidate[cellIdx / 64] };
+				const uint64_t bit{ uint64_t{ 1 } << (cellIdx % 64) };
+				if (word & bit) return;
+
+				word |= bit;
+				candidates.push_back(cellIdx);
+			} };
+		for (const int cellIdx : frontier)
+		{
+			const int x{ cellIdx % sizeX };
+			const int y{ cellIdx / sizeX };
+			if (x > 0) addCandidate(cellIdx - 1);
+			if (x + 1 < sizeX) addCandidate(cellIdx + 1);
+			if (y > 0) addCandidate(cellIdx - sizeX);
+			if (y + 1 < sizeY) addCandidate(cellIdx + sizeX);
+		}
+		for (const int cellIdx : candidates)
+		{
+			isCandidate[cellIdx / 64] = 0;
+		}
+	}
 }
 
 void Erosion::RiverLand::OnGUI()
 {
 	ImGui::Spacing();
 	ImGui::Text("River Land Settings");
-	ImGui::SliderFloat("RiverHeight", &m_RiverHeight, 0.0f, 1.0f, "%.5f");
+	ImGui::Checkbox("Rivers From Drainage", &m_UseDrainage);
+	if (m_UseDrainage) ImGui::SliderInt("River Accumulation", &m_RiverAccumulation, 1, 10'000);
+	else ImGui::SliderFloat("RiverHeight", &m_RiverHeight, 0.0f, 1.0f, "%.5f");
 	ImGui::SliderFloat("Height Divider", &m_Divider, 16.0f, 1024.0f);
 	ImGui::SliderInt("Blur Intensity", &m_BlurSize, 1, 15);
 	ImGui::SliderFloat("Cliff Threshold", &m_CliffThreshold, 0.0f, 0.015f, "%.5f");
 	ImGui::Checkbox("Do Cliff Detection", &m_DoCliffDetection);
-}
\ No newline at end of file
+}
@@ -1,30 +1,47 @@
 #pragma once
 
 #include "ITerrainGenerator.h"
+#include "../Data/HeightTile.h"
+
+#include <vector>
+#include <cstdint>
 
 namespace Erosion
 {
+	// Raises the terrain with the distance to the closest river, so the land rises away from the rivers
 	class RiverLand final : public ITerrainGenerator
 	{
 	public:
 		virtual ~RiverLand() = default;
 
+		virtual void SetChunk(int x, int y) override { m_ChunkX = x; m_ChunkY = y; }
 		virtual void GetHeights(Heightmap& heights) override;
 		virtual void OnGUI() override;
 	private:
-		struct RiverLandCell final
-		{
-			int x{};
-			int z{};
-			float slope{};
-			float distance{ FLT_MAX };
-			bool isChecked{};
-		};
+		// Returns a byte for every cell of the tile that is 1 for river cells
+		//	With drainage the rivers are the cells that enough water drains through, otherwise every cell below the river height is a river
+		std::vector<uint8_t> FindRivers(const HeightTile& tile) const;
+		// Returns the distance from every cell of the tile to the closest river cell, in steps of 1 / m_StepsPerHeight
+		//	Cells that can't reach a river inside the tile get UINT32_MAX
+		std::vector<uint32_t> CalculateDistances(const HeightTile& tile, const std::vector<uint8_t>& isRiver) const;
+		void RemoveCliffs(HeightTile& tile) const;
+
+		// The amount of cells around the chunk that are searched for rivers, rivers further away don't change the chunk
+		static constexpr int m_HaloSize{ 64 };
+		// The distances are rounded to whole steps, so the cells can be sorted in buckets instead of a heap
+		static constexpr uint32_t m_StepsPerHeight{ 4096 };
 
 		float m_RiverHeight{ 0.44182f };
 		float m_Divider{ 878.0f };
 		float m_CliffThreshold{ 0.01177f };
 		int m_BlurSize{ 9 };
 		bool m_DoCliffDetection{ true };
+		bool m_UseDrainage{ true };
+		// The amount of cells that must drain through a cell before it counts as a river
+		int m_RiverAccumulation{ 400 };
+
+		// Chunk data
+		int m_ChunkX{};
+		int m_ChunkY{};
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,86 @@
+#include "Smoothing.h"
+#include "HeightFilters.h"
+#include "../Data/HeightTile.h"
+
+#include <ImGui/imgui.h>
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+void Erosion::Smoothing::GetHeights(Heightmap& heights)
+{
+	// Terrain data
+	const int terrainSize{ heights.GetSize() };
+	const int chunkOriginX{ terrainSize / 2 + m_ChunkX * (terrainSize - 1) };
+	const int chunkOriginY{ terrainSize / 2 + m_ChunkY * (terrainSize - 1) };
+
+	// The tile holds the chunk and every cell around it that the filter reads, so the chunk blends into its neighbours
+	const int haloSize{ GetHaloSize() };
+	const int tileSize{ terrainSize + 2 * haloSize };
+	HeightTile tile{ chunkOriginX - haloSize, chunkOriginY - haloSize, tileSize, tileSize };
+	tile.Load(heights);
+
+	switch (m_Filter)
+	{
+	case Filter::Box:
+		HeightFilters::BoxBlur(tile, m_BoxRadius);
+		break;
+	case Filter::Gaussian:
+		HeightFilters::GaussianBlur(tile, m_GaussianSigma);
+		break;
+	case Filter::EdgeAware:
+		HeightFilters::EdgeAwareBlur(tile, m_EdgeSpatialSigma, m_EdgeHeightSigma, m_EdgeIterations);
+		break;
+	}
+
+	// Only the chunk is written, the halo was only needed to filter the edges of the chunk
+	HeightTile chunk{ chunkOriginX, chunkOriginY, terrainSize, terrainSize };
+	for (int y{ chunkOriginY }; y < chunkOriginY + terrainSize; ++y)
+	{
+		std::copy_n(tile.GetData() + tile.GetIndex(chunkOriginX, y), terrainSize, chunk.GetData() + chunk.GetIndex(chunkOriginX, y));
+	}
+	chunk.Store(heights);
+}
+
+int Erosion::Smoothing::GetHaloSize() const
+{
+	switch (m_Filter)
+	{
+	case Filter::Box:
+		return std::max(m_BoxRadius, 0);
+	case Filter::Gaussian:
+	{
+		const std::vector<int> radii{ HeightFilters::GetGaussianRadii(m_GaussianSigma) };
+		return std::accumulate(begin(radii), end(radii), 0);
+	}
+	case Filter::EdgeAware:
+		// The recursive filter reaches the whole tile, but cells further than three sigma away barely change a cell
+		return static_cast<int>(std::ceil(3.0f * std::max(m_EdgeSpatialSigma, 0.0f)));
+	}
+	return 0;
+}
+
+void Erosion::Smoothing::OnGUI()
+{
+	ImGui::Spacing();
+	ImGui::Text("Smoothing Settings");
+
+	int filterIdx{ static_cast<int>(m_Filter) };
+	if (ImGui::Combo("Filter", &filterIdx, m_FilterStr, m_NrFilters)) m_Filter = static_cast<Filter>(filterIdx);
+
+	switch (m_Filter)
+	{
+	case Filter::Box:
+		ImGui::SliderInt("Box Radius", &m_BoxRadius, 0, 16);
+		break;
+	case Filter::Gaussian:
+		ImGui::SliderFloat("Sigma", &m_GaussianSigma, 0.0f, 16.0f);
+		break;
+	case Filter::EdgeAware:
+		ImGui::SliderFloat("Spatial Sigma", &m_EdgeSpatialSigma, 0.0f, 32.0f);
+		ImGui::SliderFloat("Height Sigma", &m_EdgeHeightSigma, 0.0f, 0.05f, "%.5f");
+		ImGui::SliderInt("Iterations", &m_EdgeIterations, 1, 5);
+		break;
+	}
+}
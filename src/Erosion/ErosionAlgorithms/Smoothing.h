@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ITerrainGenerator.h"
+
+namespace Erosion
+{
+	// Smooths the heights of a chunk with one of the height filters, so it can run after another generator in an erosion chain
+	class Smoothing final : public ITerrainGenerator
+	{
+	public:
+		enum class Filter
+		{
+			Box,
+			Gaussian,
+			EdgeAware
+		};
+
+		virtual ~Smoothing() = default;
+
+		void SetFilter(Filter filter) { m_Filter = filter; }
+
+		virtual void SetChunk(int x, int y) override { m_ChunkX = x; m_ChunkY = y; }
+		virtual void GetHeights(Heightmap& heights) override;
+		virtual void OnGUI() override;
+
+	private:
+		// Returns the amount of cells around the chunk that the filter reads
+		int GetHaloSize() const;
+
+		inline const static int m_NrFilters{ 3 };
+		inline const static char* m_FilterStr[m_NrFilters]{ "Box", "Gaussian", "Edge Aware" };
+
+		Filter m_Filter{ Filter::Gaussian };
+		int m_BoxRadius{ 2 };
+		float m_GaussianSigma{ 1.5f };
+		float m_EdgeSpatialSigma{ 4.0f };
+		float m_EdgeHeightSigma{ 0.002f };
+		int m_EdgeIterations{ 3 };
+
+		// Chunk data
+		int m_ChunkX{};
+		int m_ChunkY{};
+	};
+}
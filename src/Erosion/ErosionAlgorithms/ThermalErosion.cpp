@@ -0,0 +1,107 @@
+#include "ThermalErosion.h"
+
+#include <ImGui/imgui.h>
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <vector>
+#include <cmath>
+#include <utility>
+
+void Erosion::ThermalErosion::GetHeights(Heightmap& heights)
+{
+	// Terrain data
+	const int terrainSize{ heights.GetSize() };
+
+	// The tile holds the chunk and the halo around it
+	const int tileSize{ terrainSize + 2 * m_HaloSize };
+	const int tileOriginX{ terrainSize / 2 + m_ChunkX * (terrainSize - 1) - m_HaloSize };
+	const int tileOriginY{ terrainSize / 2 + m_ChunkY * (terrainSize - 1) - m_HaloSize };
+
+	HeightTile tile{ tileOriginX, tileOriginY, tileSize, tileSize };
+	tile.Load(heights);
+	HeightTile nextTile{ tile };
+
+	// Divide the rows of the chunk in bands, so every thread handles a few rows at once
+	const int firstX{ tileOriginX + m_HaloSize };
+	const int firstY{ tileOriginY + m_HaloSize };
+	const int nrBands{ (terrainSize + m_BandHeight - 1) / m_BandHeight };
+	std::vector<int> bandIndices(nrBands);
+	std::iota(begin(bandIndices), end(bandIndices), 0);
+
+	for (int iterationIdx{}; iterationIdx < m_Iterations; ++iterationIdx)
+	{
+		std::for_each(std::execution::par, begin(bandIndices), end(bandIndices), [&](int bandIdx)
+			{
+				const int bandEndY{ std::min(firstY + (bandIdx + 1) * m_BandHeight, firstY + terrainSize) };
+				for (int y{ firstY + bandIdx * m_BandHeight }; y < bandEndY; ++y)
+				{
+					Relax(tile, nextTile, y, firstX, firstX + terrainSize);
+				}
+			});
+
+		// The halo is never written, so both tiles keep the same halo
+		std::swap(tile, nextTile);
+	}
+
+	// The halo is never changed, so writing it again leaves the neighbouring chunks as they were
+	//	This means the material that slid over the edge of the chunk was added or removed on one side only
+	tile.Store(heights);
+}
+
+void Erosion::ThermalErosion::Relax(const HeightTile& tile, HeightTile& nextTile, int y, int firstX, int endX) const
+{
+	// Diagonal neighbours are further away, so they can hold a larger height difference
+	const float talusHeight{ m_TalusHeight };
+	const float diagonalTalusHeight{ m_TalusHeight * std::sqrt(2.0f) };
+	const float strength{ m_Strength };
+
+	// The rows above and below the row, every pointer points at the first cell of the span
+	const int stride{ tile.GetSizeX() };
+	const float* pCenter{ tile.GetData() + tile.GetIndex(firstX, y) };
+	const float* pTop{ pCenter - stride };
+	const float* pBottom{ pCenter + stride };
+	float* pNext{ nextTile.GetData() + nextTile.GetIndex(firstX, y) };
+
+	// Calculate the material that slides between a cell and each neighbour
+	//	The amount between two cells is the same for both cells with the opposite sign, so no material is lost between two cells of the chunk
+	//	A halo cell is never written, so the material between a cell at the edge and the halo only changes the cell at the edge
+	//	This is the difference minus the difference clamped to the talus, written with abs because compilers turn a clamp into branches without fast math
+	//	Without branches the compiler can turn the loop into vector instructions
+	const auto slide{ [](float difference, float talus) { return difference + 0.5f * (std::abs(difference - talus) - std::abs(difference + talus)); } };
+
+	const int nrCells{ endX - firstX };
+	for (int i{}; i < nrCells; ++i)
+	{
+		const float height{ pCenter[i] };
+
+		const float straight{ slide(pCenter[i - 1] - height, talusHeight) + slide(pCenter[i + 1] - height, talusHeight)
+			+ slide(pTop[i] - height, talusHeight) + slide(pBottom[i] - height, talusHeight) };
+		const float diagonal{ slide(pTop[i - 1] - height, diagonalTalusHeight) + slide(pTop[i + 1] - height, diagonalTalusHeight)
+			+ slide(pBottom[i - 1] - height, diagonalTalusHeight) + slide(pBottom[i + 1] - height, diagonalTalusHeight) };
+
+		pNext[i] = height + strength * (straight + diagonal);
+	}
+}
+
+Erosion::ThermalErosion::Settings Erosion::ThermalErosion::GetSettings() const
+{
+	return Settings{ m_Iterations, m_TalusHeight, m_Strength };
+}
+
+void Erosion::ThermalErosion::SetSettings(const Settings& settings)
+{
+	m_Iterations = settings.iterations;
+	m_TalusHeight = settings.talusHeight;
+	m_Strength = settings.strength;
+}
+
+void Erosion::ThermalErosion::OnGUI()
+{
+	ImGui::Spacing();
+	ImGui::Text("Thermal Erosion Settings");
+	ImGui::SliderInt("Nr Iterations", &m_Iterations, 0, 500);
+	ImGui::SliderFloat("Talus Height", &m_TalusHeight, 0.0f, 0.005f, "%.5f");
+	ImGui::SliderFloat("Strength", &m_Strength, 0.0f, 0.125f);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ITerrainGenerator.h"
+#include "../Data/HeightTile.h"
+
+namespace Erosion
+{
+	// Thermal erosion, material slides down every slope that is steeper than the talus angle until the slope can hold it
+	//	Every iteration is a Jacobi sweep, each cell only reads the heights of the previous iteration so the rows can be handled in any order
+	//	The halo around the chunk is only read, so the material that slides over the edge of the chunk is only gained or lost by the cells at the edge
+	//	In a chain the stage runs as soon as the chunk is eroded, droplets of neighbouring chunks that are eroded later can still leave artifacts near the edge
+	class ThermalErosion final : public ITerrainGenerator
+	{
+	public:
+		// The values that change the shape of the erosion, so they can be tuned without the viewer
+		struct Settings final
+		{
+			int iterations{};
+			float talusHeight{};
+			float strength{};
+		};
+
+		virtual ~ThermalErosion() = default;
+
+		Settings GetSettings() const;
+		void SetSettings(const Settings& settings);
+
+		virtual void SetChunk(int x, int y) override { m_ChunkX = x; m_ChunkY = y; }
+		virtual void GetHeights(Heightmap& heights) override;
+		virtual void OnGUI() override;
+
+	private:
+		// Calculates the heights of the next iteration for the cells [firstX, endX) of row y, both tiles use the same rectangle
+		void Relax(const HeightTile& tile, HeightTile& nextTile, int y, int firstX, int endX) const;
+
+		// The amount of cells around the chunk that are copied from the neighbouring chunks, they are read but never changed
+		//	Changing them would change a neighbouring chunk that may still be eroded or relaxed on another thread
+		static constexpr int m_HaloSize{ 1 };
+		// The amount of rows that a thread handles at once
+		static constexpr int m_BandHeight{ 16 };
+
+		int m_Iterations{ 50 };
+		// The largest height difference between two neighbouring cells that doesn't slide, just above the steepest slopes of the noise so only the erosion artifacts slide
+		float m_TalusHeight{ 0.0005f };
+		// The part of the height above the talus that moves to a neighbour every iteration, more than 1/8 lets a cell overshoot its neighbours
+		float m_Strength{ 0.1f };
+
+		// Chunk data
+		int m_ChunkX{};
+		int m_ChunkY{};
+	};
+}
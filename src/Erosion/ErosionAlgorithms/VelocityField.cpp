@@ -1,304 +1,488 @@
 #include "VelocityField.h"
 
 #include <ImGui/imgui.h>
-#include <Debug.h>
 
-void Erosion::VelocityField::GetHeights(Heightmap& /*heights*/)
+#include <algorithm>
+#include <array>
+#include <execution>
+#include <numeric>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+
+void Erosion::VelocityField::GetHeights(Heightmap& heights)
+{
+	// Terrain data
+	const int terrainSize{ heights.GetSize() };
+
+	// The grid holds the chunk and the halo around it
+	const int gridSize{ terrainSize + 2 * m_HaloSize };
+	const int gridOriginX{ terrainSize / 2 + m_ChunkX * (terrainSize - 1) - m_HaloSize };
+	const int gridOriginY{ terrainSize / 2 + m_ChunkY * (terrainSize - 1) - m_HaloSize };
+	const Area chunkArea{ m_HaloSize, m_HaloSize, gridSize - m_HaloSize, gridSize - m_HaloSize };
+
+	PipeGrid grid{ Area{ 0, 0, gridSize, gridSize } };
+	heights.ReadRegion(gridOriginX, gridOriginY, gridSize, gridSize, grid.terrain.GetData());
+	grid.nextTerrain = grid.terrain;
+
+	// The water of cycle i always falls on the same cells of a world, no matter which chunks were eroded before
+	const CounterRandom random{ heights.GetSeed(), m_ChunkX, m_ChunkY };
+
+	if (m_UseTemporalBlocking)
+	{
+		// Divide the chunk in blocks of about the same size
+		const int chunkSize{ chunkArea.endX - chunkArea.firstX };
+		const int nrBlocksPerSide{ (chunkSize + m_BlockSize - 1) / m_BlockSize };
+		const int blockSize{ (chunkSize + nrBlocksPerSide - 1) / nrBlocksPerSide };
+
+		// Every block gets its own grid that is large enough for the margin of all the cycles of a block
+		std::vector<Area> blocks{};
+		std::vector<PipeGrid> blockGrids{};
+		for (int blockY{ chunkArea.firstY }; blockY < chunkArea.endY; blockY += blockSize)
+		{
+			for (int blockX{ chunkArea.firstX }; blockX < chunkArea.endX; blockX += blockSize)
+			{
+				const Area block{ blockX, blockY, std::min(blockX + blockSize, chunkArea.endX), std::min(blockY + blockSize, chunkArea.endY) };
+				blocks.push_back(block);
+				blockGrids.emplace_back(Grow(block, m_StepsPerBlock * m_StepRadius, Area{ 0, 0, gridSize, gridSize }));
+			}
+		}
+
+		for (int cycleIdx{}; cycleIdx < m_Cycles; cycleIdx += m_StepsPerBlock)
+		{
+			SimulateBlocks(grid, blocks, blockGrids, chunkArea, random, cycleIdx, std::min(m_StepsPerBlock, m_Cycles - cycleIdx));
+		}
+	}
+	else
+	{
+		const int nrBlocksPerSide{ (chunkArea.endX - chunkArea.firstX + m_BandHeight - 1) / m_BandHeight };
+		ActiveBlocks activeBlocks{ nrBlocksPerSide, nrBlocksPerSide };
+
+		for (int cycleIdx{}; cycleIdx < m_Cycles; ++cycleIdx)
+		{
+			Simulate(grid, chunkArea, m_StepRadius, chunkArea, random, cycleIdx, &activeBlocks);
+		}
+	}
+
+	SettleSediment(grid, chunkArea);
+
+	// The halo is never changed, so writing it again leaves the neighbouring chunks as they were
+	heights.WriteRegion(gridOriginX, gridOriginY, gridSize, gridSize, grid.terrain.GetData());
+}
+
+void Erosion::VelocityField::Simulate(PipeGrid& grid, const Area& area, int margin, const Area& chunkArea, const CounterRandom& random, int cycleIdx, ActiveBlocks* pActiveBlocks) const
+{
+	AddWater(grid, Grow(area, margin, chunkArea), chunkArea, random, cycleIdx, pActiveBlocks);
+
+	if (pActiveBlocks) UpdateVisitedBlocks(grid, area, *pActiveBlocks);
+
+	// Every pass reads the neighbours of its cells, so it can only be correct one cell further inside than the pass before it
+	CalculateFlux(grid, Grow(area, margin - 1, chunkArea), pActiveBlocks);
+	CalculateVelocity(grid, Grow(area, margin - 2, chunkArea), pActiveBlocks);
+	TransportSediment(grid, Grow(area, margin - m_StepRadius, chunkArea), pActiveBlocks);
+
+	if (pActiveBlocks) UpdateActiveBlocks(grid, area, *pActiveBlocks);
+}
+
+void Erosion::VelocityField::SimulateBlocks(PipeGrid& grid, const std::vector<Area>& blocks, std::vector<PipeGrid>& blockGrids, const Area& chunkArea, const CounterRandom& random, int firstCycleIdx, int nrCycles) const
+{
+	const Area gridArea{ 0, 0, grid.terrain.GetSizeX(), grid.terrain.GetSizeY() };
+
+	// Every block simulates all the cycles on its own copy, so the blocks can't see the changes of the other blocks too early
+	std::vector<int> blockIndices(blocks.size());
+	std::iota(begin(blockIndices), end(blockIndices), 0);
+	std::for_each(std::execution::par, begin(blockIndices), end(blockIndices), [&](int blockIdx)
+		{
+			PipeGrid& blockGrid{ blockGrids[blockIdx] };
+			CopyState(grid, blockGrid, Grow(blocks[blockIdx], nrCycles * m_StepRadius, gridArea));
+			blockGrid.nextTerrain = blockGrid.terrain;
+
+			for (int stepIdx{}; stepIdx < nrCycles; ++stepIdx)
+			{
+				Simulate(blockGrid, blocks[blockIdx], (nrCycles - stepIdx) * m_StepRadius, chunkArea, random, firstCycleIdx + stepIdx, nullptr);
+			}
+		});
+
+	// Write the blocks back once every block has finished
+	std::for_each(std::execution::par, begin(blockIndices), end(blockIndices), [&](int blockIdx)
+		{
+			CopyState(blockGrids[blockIdx], grid, blocks[blockIdx]);
+		});
+}
+
+void Erosion::VelocityField::AddWater(PipeGrid& grid, const Area& area, const Area& chunkArea, const CounterRandom& random, int cycleIdx, ActiveBlocks* pActiveBlocks) const
+{
+	const float chunkSize{ static_cast<float>(chunkArea.endX - chunkArea.firstX) };
+
+	// Spawn droplets on random cells inside the chunk, only the droplets inside the area are added
+	for (int dropletIdx{}; dropletIdx < m_DropletsPerCycle; ++dropletIdx)
+	{
+		const uint32_t counter{ static_cast<uint32_t>(cycleIdx * m_DropletsPerCycle + dropletIdx) };
+		const int x{ chunkArea.firstX + static_cast<int>(random.GetFloat01(counter, 0) * chunkSize) };
+		const int y{ chunkArea.firstY + static_cast<int>(random.GetFloat01(counter, 1) * chunkSize) };
+
+		if (x < area.firstX || y < area.firstY || x >= area.endX || y >= area.endY) continue;
+
+		grid.water[grid.GetIndex(x, y)] += m_WaterIncrement * m_TimeStep;
+
+		if (pActiveBlocks)
+		{
+			const int blockIdx{ (x - area.firstX) / m_BandHeight + (y - area.firstY) / m_BandHeight * pActiveBlocks->nrBlocksX };
+			pActiveBlocks->isActive[blockIdx] = true;
+		}
+	}
+}
+
+void Erosion::VelocityField::CalculateFlux(PipeGrid& grid, const Area& area, const ActiveBlocks* pActiveBlocks) const
+{
+	ForEachSpan(area, pActiveBlocks, [this, &grid](int y, int firstX, int endX)
+		{
+			int x{ firstX };
+			for (; x + m_VectorWidth <= endX; x += m_VectorWidth) CalculateFlux<m_VectorWidth>(grid, x, y);
+			for (; x < endX; ++x) CalculateFlux<1>(grid, x, y);
+		});
+}
+
+void Erosion::VelocityField::CalculateVelocity(PipeGrid& grid, const Area& area, const ActiveBlocks* pActiveBlocks) const
+{
+	ForEachSpan(area, pActiveBlocks, [this, &grid](int y, int firstX, int endX)
+		{
+			int x{ firstX };
+			for (; x + m_VectorWidth <= endX; x += m_VectorWidth) CalculateVelocity<m_VectorWidth>(grid, x, y);
+			for (; x < endX; ++x) CalculateVelocity<1>(grid, x, y);
+		});
+
+	std::swap(grid.terrain, grid.nextTerrain);
+}
+
+void Erosion::VelocityField::TransportSediment(PipeGrid& grid, const Area& area, const ActiveBlocks* pActiveBlocks) const
+{
+	ForEachSpan(area, pActiveBlocks, [this, &grid](int y, int firstX, int endX)
+		{
+			int x{ firstX };
+			for (; x + m_VectorWidth <= endX; x += m_VectorWidth) TransportSediment<m_VectorWidth>(grid, x, y);
+			for (; x < endX; ++x) TransportSediment<1>(grid, x, y);
+		});
+
+	std::swap(grid.sediment, grid.nextSediment);
+}
+
+void Erosion::VelocityField::SettleSediment(PipeGrid& grid, const Area& area) const
+{
+	// Drop the sediment that the water still carries when the simulation ends
+	for (int y{ area.firstY }; y < area.endY; ++y)
+	{
+		for (int x{ area.firstX }; x < area.endX; ++x)
+		{
+			grid.terrain.GetHeight(x, y) += grid.sediment[grid.GetIndex(x, y)];
+		}
+	}
+}
+
+void Erosion::VelocityField::CopyState(const PipeGrid& source, PipeGrid& destination, const Area& area)
+{
+	// The velocity is calculated again every cycle before it is used, so it isn't part of the state
+	const int width{ area.endX - area.firstX };
+	for (int y{ area.firstY }; y < area.endY; ++y)
+	{
+		const int sourceIdx{ source.GetIndex(area.firstX, y) };
+		const int destinationIdx{ destination.GetIndex(area.firstX, y) };
+		const auto copyRow{ [sourceIdx, destinationIdx, width](const float* pSource, float* pDestination)
+			{
+				std::copy_n(pSource + sourceIdx, width, pDestination + destinationIdx);
+			} };
+
+		copyRow(source.terrain.GetData(), destination.terrain.GetData());
+		copyRow(source.water.data(), destination.water.data());
+		copyRow(source.fluxLeft.data(), destination.fluxLeft.data());
+		copyRow(source.fluxRight.data(), destination.fluxRight.data());
+		copyRow(source.fluxTop.data(), destination.fluxTop.data());
+		copyRow(source.fluxBottom.data(), destination.fluxBottom.data());
+		copyRow(source.sediment.data(), destination.sediment.data());
+	}
+}
+
+Erosion::VelocityField::Area Erosion::VelocityField::Grow(const Area& area, int nrCells, const Area& limits)
+{
+	return Area
+	{
+		std::max(area.firstX - nrCells, limits.firstX),
+		std::max(area.firstY - nrCells, limits.firstY),
+		std::min(area.endX + nrCells, limits.endX),
+		std::min(area.endY + nrCells, limits.endY)
+	};
+}
+
+void Erosion::VelocityField::UpdateVisitedBlocks(PipeGrid& grid, const Area& area, ActiveBlocks& activeBlocks) const
+{
+	std::swap(activeBlocks.isVisited, activeBlocks.wasVisited);
+
+	// Water moves less than a block per cycle, so it can only reach the blocks next to a block with water
+	for (int blockY{}; blockY < activeBlocks.nrBlocksY; ++blockY)
+	{
+		for (int blockX{}; blockX < activeBlocks.nrBlocksX; ++blockX)
+		{
+			bool isVisited{};
+			for (int neighbourY{ std::max(blockY - 1, 0) }; neighbourY <= std::min(blockY + 1, activeBlocks.nrBlocksY - 1); ++neighbourY)
+			{
+				for (int neighbourX{ std::max(blockX - 1, 0) }; neighbourX <= std::min(blockX + 1, activeBlocks.nrBlocksX - 1); ++neighbourX)
+				{
+					isVisited = isVisited || activeBlocks.isActive[neighbourX + neighbourY * activeBlocks.nrBlocksX];
+				}
+			}
+
+			const int blockIdx{ blockX + blockY * activeBlocks.nrBlocksX };
+			activeBlocks.isVisited[blockIdx] = isVisited;
+
+			// The second buffers of a block that was visited last cycle still hold the values of the cycle before
+			if (isVisited || !activeBlocks.wasVisited[blockIdx]) continue;
+
+			const int firstX{ area.firstX + blockX * m_BandHeight };
+			const int width{ std::min(firstX + m_BandHeight, area.endX) - firstX };
+			for (int y{ area.firstY + blockY * m_BandHeight }; y < std::min(area.firstY + (blockY + 1) * m_BandHeight, area.endY); ++y)
+			{
+				const int cellIdx{ grid.GetIndex(firstX, y) };
+				std::copy_n(grid.terrain.GetData() + cellIdx, width, grid.nextTerrain.GetData() + cellIdx);
+				std::copy_n(grid.sediment.data() + cellIdx, width, grid.nextSediment.data() + cellIdx);
+			}
+		}
+	}
+}
+
+void Erosion::VelocityField::UpdateActiveBlocks(const PipeGrid& grid, const Area& area, ActiveBlocks& activeBlocks) const
+{
+	ForEachVisitedBlock(area, activeBlocks, [&grid, &activeBlocks](int blockIdx, const Area& block)
+		{
+			bool hasWater{};
+			for (int y{ block.firstY }; y < block.endY; ++y)
+			{
+				const float* pWater{ grid.water.data() + grid.GetIndex(block.firstX, y) };
+				hasWater = hasWater || std::any_of(pWater, pWater + (block.endX - block.firstX), [](float water) { return water > 0.0f; });
+			}
+			activeBlocks.isActive[blockIdx] = hasWater;
+		});
+}
+
+template<typename Function>
+void Erosion::VelocityField::ForEachSpan(const Area& area, const ActiveBlocks* pActiveBlocks, const Function& function) const
+{
+	if (!pActiveBlocks)
+	{
+		for (int y{ area.firstY }; y < area.endY; ++y)
+		{
+			function(y, area.firstX, area.endX);
+		}
+		return;
+	}
+
+	ForEachVisitedBlock(area, *pActiveBlocks, [&function](int, const Area& block)
+		{
+			for (int y{ block.firstY }; y < block.endY; ++y)
+			{
+				function(y, block.firstX, block.endX);
+			}
+		});
+}
+
+template<typename Function>
+void Erosion::VelocityField::ForEachVisitedBlock(const Area& area, const ActiveBlocks& activeBlocks, const Function& function) const
+{
+	std::vector<int> bandIndices(activeBlocks.nrBlocksY);
+	std::iota(begin(bandIndices), end(bandIndices), 0);
+	std::for_each(std::execution::par, begin(bandIndices), end(bandIndices), [&area, &activeBlocks, &function](int blockY)
+		{
+			for (int blockX{}; blockX < activeBlocks.nrBlocksX; ++blockX)
+			{
+				const int blockIdx{ blockX + blockY * activeBlocks.nrBlocksX };
+				if (!activeBlocks.isVisited[blockIdx]) continue;
+
+				const int firstX{ area.firstX + blockX * m_BandHeight };
+				const int firstY{ area.firstY + blockY * m_BandHeight };
+				function(blockIdx, Area{ firstX, firstY, std::min(firstX + m_BandHeight, area.endX), std::min(firstY + m_BandHeight, area.endY) });
+			}
+		});
+}
+
+template<int NrCells>
+void Erosion::VelocityField::CalculateFlux(PipeGrid& grid, int x, int y) const
+{
+	const int stride{ grid.GetStride() };
+	const int firstCellIdx{ grid.GetIndex(x, y) };
+	const float* pTerrain{ grid.terrain.GetData() + firstCellIdx };
+	const float* pWater{ grid.water.data() + firstCellIdx };
+
+	// Gravity points down, so a positive height difference pushes water through the pipe
+	const float fluxFactor{ m_TimeStep * m_PipeArea * -m_Gravity / m_PipeLength };
+
+	std::array<float, NrCells> fluxL{};
+	std::array<float, NrCells> fluxR{};
+	std::array<float, NrCells> fluxT{};
+	std::array<float, NrCells> fluxB{};
+
+	for (int cellIdx{}; cellIdx < NrCells; ++cellIdx)
+	{
+		const float surfaceHeight{ pTerrain[cellIdx] + pWater[cellIdx] };
+
+		// Calculate the flux through every pipe, the halo makes sure every neighbour exists
+		const float newFluxL{ std::max(0.0f, grid.fluxLeft[firstCellIdx + cellIdx] + fluxFactor * (surfaceHeight - pTerrain[cellIdx - 1] - pWater[cellIdx - 1])) };
+		const float newFluxR{ std::max(0.0f, grid.fluxRight[firstCellIdx + cellIdx] + fluxFactor * (surfaceHeight - pTerrain[cellIdx + 1] - pWater[cellIdx + 1])) };
+		const float newFluxT{ std::max(0.0f, grid.fluxTop[firstCellIdx + cellIdx] + fluxFactor * (surfaceHeight - pTerrain[cellIdx + stride] - pWater[cellIdx + stride])) };
+		const float newFluxB{ std::max(0.0f, grid.fluxBottom[firstCellIdx + cellIdx] + fluxFactor * (surfaceHeight - pTerrain[cellIdx - stride] - pWater[cellIdx - stride])) };
+
+		// Fix floating point errors
+		fluxL[cellIdx] = newFluxL < m_FluxEpsilon ? 0.0f : newFluxL;
+		fluxR[cellIdx] = newFluxR < m_FluxEpsilon ? 0.0f : newFluxR;
+		fluxT[cellIdx] = newFluxT < m_FluxEpsilon ? 0.0f : newFluxT;
+		fluxB[cellIdx] = newFluxB < m_FluxEpsilon ? 0.0f : newFluxB;
+	}
+
+	for (int cellIdx{}; cellIdx < NrCells; ++cellIdx)
+	{
+		// Calculate the limit multiplier so water in the current cell won't go negative
+		//	Without any flux the multiplier doesn't matter, so the sum is only kept above zero to avoid a branch
+		const float fluxSum{ fluxL[cellIdx] + fluxR[cellIdx] + fluxT[cellIdx] + fluxB[cellIdx] };
+		const float k{ std::min(1.0f, pWater[cellIdx] / std::max(fluxSum * m_TimeStep, FLT_EPSILON)) };
+
+		grid.fluxLeft[firstCellIdx + cellIdx] = fluxL[cellIdx] * k;
+		grid.fluxRight[firstCellIdx + cellIdx] = fluxR[cellIdx] * k;
+		grid.fluxTop[firstCellIdx + cellIdx] = fluxT[cellIdx] * k;
+		grid.fluxBottom[firstCellIdx + cellIdx] = fluxB[cellIdx] * k;
+	}
+}
+
+template<int NrCells>
+void Erosion::VelocityField::CalculateVelocity(PipeGrid& grid, int x, int y) const
+{
+	const int stride{ grid.GetStride() };
+	const int firstCellIdx{ grid.GetIndex(x, y) };
+	const float* pTerrain{ grid.terrain.GetData() + firstCellIdx };
+	const float* pFluxLeft{ grid.fluxLeft.data() + firstCellIdx };
+	const float* pFluxRight{ grid.fluxRight.data() + firstCellIdx };
+	const float* pFluxTop{ grid.fluxTop.data() + firstCellIdx };
+	const float* pFluxBottom{ grid.fluxBottom.data() + firstCellIdx };
+
+	std::array<float, NrCells> water{};
+	std::array<float, NrCells> velocityX{};
+	std::array<float, NrCells> velocityY{};
+	std::array<float, NrCells> sediment{};
+	std::array<float, NrCells> terrain{};
+
+	for (int cellIdx{}; cellIdx < NrCells; ++cellIdx)
+	{
+		// Retrieve incoming flux values from neighbouring cells, the halo has no flux so nothing flows back into the chunk
+		const float incomingFluxL{ pFluxRight[cellIdx - 1] };
+		const float incomingFluxR{ pFluxLeft[cellIdx + 1] };
+		const float incomingFluxT{ pFluxBottom[cellIdx + stride] };
+		const float incomingFluxB{ pFluxTop[cellIdx - stride] };
+
+		const float outgoingFluxL{ pFluxLeft[cellIdx] };
+		const float outgoingFluxR{ pFluxRight[cellIdx] };
+		const float outgoingFluxT{ pFluxTop[cellIdx] };
+		const float outgoingFluxB{ pFluxBottom[cellIdx] };
+
+		// Calculate the volume change by adding incoming flux and substracting outgoing flux from this cell
+		const float volumeChange
+		{
+			m_TimeStep * (incomingFluxL + incomingFluxR + incomingFluxT + incomingFluxB
+			- outgoingFluxL - outgoingFluxR - outgoingFluxT - outgoingFluxB)
+		};
+
+		// Calculate new water height and average water height over the current cycle
+		const float oldWater{ grid.water[firstCellIdx + cellIdx] };
+		const float averageWaterHeight{ oldWater + volumeChange / 2.0f };
+		water[cellIdx] = oldWater + volumeChange;
+
+		// Calculate water movement per direction
+		const float waterMovementX{ (incomingFluxL + outgoingFluxR - incomingFluxR - outgoingFluxL) / 2.0f };
+		const float waterMovementY{ (incomingFluxB + outgoingFluxT - incomingFluxT - outgoingFluxB) / 2.0f };
+
+		// Calculate velocity depending on the water movement and water height, cells without water have no velocity
+		//	The velocity is multiplied by a mask instead of picked, otherwise the compiler moves the division behind a branch
+		const float waterMask{ averageWaterHeight >= FLT_EPSILON ? 1.0f : 0.0f };
+		velocityX[cellIdx] = waterMovementX / std::max(averageWaterHeight, FLT_EPSILON) * waterMask;
+		velocityY[cellIdx] = waterMovementY / std::max(averageWaterHeight, FLT_EPSILON) * waterMask;
+
+		// Calculate height difference from neighbouring cells
+		const float heightDiffX{ pTerrain[cellIdx + 1] - pTerrain[cellIdx - 1] };
+		const float heightDiffY{ pTerrain[cellIdx + stride] - pTerrain[cellIdx - stride] };
+		const float heightDiffSqr{ heightDiffX * heightDiffX + heightDiffY * heightDiffY };
+
+		// Calculate the sin of the local tilt angle of the current cell
+		const float sinTiltAngle{ sqrtf(heightDiffSqr) / sqrtf(heightDiffSqr + 1.0f) };
+		// Calculate the allowed capacity for the current velocity and tilt angle
+		const float curCapacity{ m_Capacity * sinTiltAngle * sqrtf(velocityX[cellIdx] * velocityX[cellIdx] + velocityY[cellIdx] * velocityY[cellIdx]) };
+
+		// Remove or add sediment to the current cell depending on the capacity
+		//	Only the cell itself changes, so every cell of the pass can be handled in any order
+		//	One of both amounts is always zero, so the group doesn't need to branch
+		const float oldSediment{ grid.sediment[firstCellIdx + cellIdx] };
+		const float erodedSediment{ m_Erosion * std::max(curCapacity - oldSediment, 0.0f) };
+		const float depositedSediment{ m_Deposition * std::max(oldSediment - curCapacity, 0.0f) };
+		const float sedimentChange{ erodedSediment - depositedSediment };
+		terrain[cellIdx] = pTerrain[cellIdx] - sedimentChange;
+		sediment[cellIdx] = oldSediment + sedimentChange;
+	}
+
+	float* pNextTerrain{ grid.nextTerrain.GetData() + firstCellIdx };
+	for (int cellIdx{}; cellIdx < NrCells; ++cellIdx)
+	{
+		grid.water[firstCellIdx + cellIdx] = water[cellIdx];
+		grid.velocityX[firstCellIdx + cellIdx] = velocityX[cellIdx];
+		grid.velocityY[firstCellIdx + cellIdx] = velocityY[cellIdx];
+		grid.sediment[firstCellIdx + cellIdx] = sediment[cellIdx];
+		pNextTerrain[cellIdx] = terrain[cellIdx];
+	}
+}
+
+template<int NrCells>
+void Erosion::VelocityField::TransportSediment(PipeGrid& grid, int x, int y) const
 {
-	//// Create a grid of cells
-	//std::vector<Cell> cells(heights.size());
-	//for (size_t i{}; i < heights.size(); ++i)
-	//{
-	//	cells[i] = Cell { &heights[i] };
-	//}
-
-	//// Erosion radius data
-	//std::vector<float> radiusWeights{};
-	//radiusWeights.resize(m_ErosionRadius * m_ErosionRadius);
-
-	//// Retrieve the terrain size
-	//const int terrainSize{ static_cast<int>(sqrtf(static_cast<float>(heights.size()))) };
-
-	//for (int i{}; i < m_Cycles; ++i)
-	//{
-	//	// Spawn droplets
-	//	for (int dropletIdx{}; dropletIdx < m_DropletsPerCycle; ++dropletIdx)
-	//	{
-	//		const int waterCellIdx{ (rand() % terrainSize) + (rand() % terrainSize) * terrainSize };
-	//		Cell& waterCell{ cells[waterCellIdx] };
-	//		waterCell.water += m_WaterIncrement * m_TimeStep;
-	//	}
-
-	//	// Calculate flux
-	//	for (int x{}; x < terrainSize; ++x)
-	//	{
-	//		for (int z{}; z < terrainSize; ++z)
-	//		{
-	//			// Get current cell
-	//			const int cellIdx{ x + z * terrainSize };
-	//			Cell& cell{ cells[cellIdx] };
-
-	//			// Get height difference if the neighbouring cell exists
-	//			float heightDiffL{};
-	//			if (x - 1 >= 0)
-	//			{
-	//				const Cell& leftCell{ cells[x - 1 + z * terrainSize] };
-	//				heightDiffL = *cell.height + cell.water - *leftCell.height - leftCell.water;
-	//			}
-	//			// Calculate the flux
-	//			float fluxL{ std::max(0.0f, cell.leftFlux + m_TimeStep * m_PipeArea * (m_Gravity * heightDiffL) / m_PipeLength) };
-	//			// Fix floating point errors
-	//			fluxL = fluxL < m_FluxEpsilon ? 0.0f : fluxL;
-
-	//			// Get height difference if the neighbouring cell exists
-	//			float heightDiffR{};
-	//			if (x + 1 < terrainSize)
-	//			{
-	//				const Cell& rightCell{ cells[x + 1 + z * terrainSize] };
-	//				heightDiffR = *cell.height + cell.water - *rightCell.height - rightCell.water;
-	//			}
-	//			// Calculate the flux
-	//			float fluxR{ std::max(0.0f, cell.rightFlux + m_TimeStep * m_PipeArea * (m_Gravity * heightDiffR) / m_PipeLength) };
-	//			// Fix floating point errors
-	//			fluxR = fluxR < m_FluxEpsilon ? 0.0f : fluxR;
-
-	//			// Get height difference if the neighbouring cell exists
-	//			float heightDiffT{};
-	//			if (z + 1 < terrainSize)
-	//			{
-	//				const Cell& topCell{ cells[x + (z + 1) * terrainSize] };
-	//				heightDiffT = *cell.height + cell.water - *topCell.height - topCell.water;
-	//			}
-	//			// Calculate the flux
-	//			float fluxT{ std::max(0.0f, cell.topFlux + m_TimeStep * m_PipeArea * (m_Gravity * heightDiffT) / m_PipeLength) };
-	//			// Fix floating point errors
-	//			fluxT = fluxT < m_FluxEpsilon ? 0.0f : fluxT;
-
-	//			// Get height difference if the neighbouring cell exists
-	//			float heightDiffB{};
-	//			if (z - 1 >= 0)
-	//			{
-	//				const Cell& bottomCell{ cells[x + (z - 1) * terrainSize] };
-	//				heightDiffB = *cell.height + cell.water - *bottomCell.height - bottomCell.water;
-	//			}
-	//			// Calculate the flux
-	//			float fluxB{ std::max(0.0f, cell.bottomFlux + m_TimeStep * m_PipeArea * (m_Gravity * heightDiffB) / m_PipeLength) };
-	//			// Fix floating point errors
-	//			fluxB = fluxB < m_FluxEpsilon ? 0.0f : fluxB;
-
-	//			// Calculate the total flux sum
-	//			const float fluxSum{ fluxL + fluxR + fluxT + fluxB };
-	//			// Calculate the limit multiplier so water in the current cell won't go negative
-	//			const float k{ fluxSum < FLT_EPSILON ? 0.0f : std::min(1.0f, cell.water / fluxSum) };
-
-	//			// Calculate the final flux values by multiplying the calculated flux values with the limit multiplier
-	//			cell.leftFlux = fluxL * k;
-	//			cell.rightFlux = fluxR * k;
-	//			cell.topFlux = fluxT * k;
-	//			cell.bottomFlux = fluxB * k;
-	//		}
-	//	}
-
-	//	// Calculate velocity and sediment
-	//	for (int x{}; x < terrainSize; ++x)
-	//	{
-	//		for (int z{}; z < terrainSize; ++z)
-	//		{
-	//			// Get current cell
-	//			const int cellIdx{ x + z * terrainSize };
-	//			Cell& cell{ cells[cellIdx] };
-
-	//			// Retrieve incoming flux values from neighbouring cells
-	//			const float incomingFluxL{ x - 1 >= 0 ? cells[x - 1 + z * terrainSize].rightFlux : 0.0f };
-	//			const float incomingFluxR{ x + 1 < terrainSize ? cells[x + 1 + z * terrainSize].leftFlux : 0.0f };
-	//			const float incomingFluxT{ z + 1 < terrainSize ? cells[x + (z + 1) * terrainSize].bottomFlux : 0.0f };
-	//			const float incomingFluxB{ z - 1 >= 0 ? cells[x + (z - 1) * terrainSize].topFlux : 0.0f };
-
-	//			// Calculate the volume change by adding incoming flux and substracting outgoing flux from this cell
-	//			const float volumeChange
-	//			{
-	//				incomingFluxL + incomingFluxR + incomingFluxT + incomingFluxB
-	//				- cell.leftFlux - cell.rightFlux - cell.topFlux - cell.bottomFlux
-	//			};
-
-	//			// Calculate new water height and average water height over the current cycle
-	//			const float averageWaterHeight{ cell.water + volumeChange / 2.0f };
-	//			cell.water += volumeChange;
-
-	//			// Calculate water movement per direction
-	//			const float waterMovementX{ (incomingFluxL + cell.rightFlux - incomingFluxR - cell.leftFlux) / 2.0f };
-	//			const float waterMovementY{ (incomingFluxB + cell.topFlux - incomingFluxT - cell.bottomFlux) / 2.0f };
-
-	//			// Calculate velocity depending on the water movement and water height
-	//			if (abs(averageWaterHeight) < FLT_EPSILON)
-	//			{
-	//				cell.velocityX = 0.0f;
-	//				cell.velocityY = 0.0f;
-	//			}
-	//			else
-	//			{
-	//				cell.velocityX = waterMovementX / averageWaterHeight;
-	//				cell.velocityY = waterMovementY / averageWaterHeight;
-	//			}
-
-	//			// Retrieve heights of neighbouring cells
-	//			const float heightL{ x - 1 >= 0 ? *cells[x - 1 + z * terrainSize].height : 0.0f };
-	//			const float heightR{ x + 1 < terrainSize ? *cells[x + 1 + z * terrainSize].height : 0.0f };
-	//			const float heightT{ z + 1 < terrainSize ? *cells[x + (z + 1) * terrainSize].height : 0.0f };
-	//			const float heightB{ z - 1 >= 0 ? *cells[x + (z - 1) * terrainSize].height : 0.0f };
-
-	//			// Calculate height difference from neighbouring cells
-	//			const float heightDiffXSqr{ (heightR - heightL) * (heightR - heightL) };
-	//			const float heightDiffYSqr{ (heightT - heightB) * (heightT - heightB) };
-
-	//			// Calculate the sin of the local tilt angle of the current cell
-	//			const float sinTiltAngle{ sqrtf(heightDiffXSqr + heightDiffYSqr) / sqrtf(heightDiffXSqr + heightDiffYSqr + 1) };
-	//			// Calcualte the magnitude of the velocity in the current cell
-	//			const float velocityMagnitude{ sqrtf(cell.velocityX * cell.velocityX + cell.velocityY * cell.velocityY) };
-	//			// Calculate the allowed capacity for the current velocity and tilt angle
-	//			const float curCapacity{ m_Capacity * sinTiltAngle * velocityMagnitude };
-
-	//			// Remove or add sediment to the current cell depending on the capacity
-	//			if (curCapacity > cell.sediment)
-	//			{
-	//				const float removedSediment{ m_Erosion * (m_Capacity - cell.sediment) };
-
-
-	//				float totalWeight{};
-	//				float smallestDistance{ FLT_MAX };
-	//				float highestDistance{};
-
-	//				// Calculate the weights of all the grid points near the droplet and their combined total weight
-	//				const int halfErosionRadius{ m_ErosionRadius / 2 };
-	//				for (int radX{}; radX < m_ErosionRadius; ++radX)
-	//				{
-	//					for (int radZ{}; radZ < m_ErosionRadius; ++radZ)
-	//					{
-	//						const int xDisplacement{ radX - halfErosionRadius };
-	//						const int zDisplacement{ radZ - halfErosionRadius };
-
-	//						const int xPos = x + xDisplacement;
-	//						const int zPos = z + zDisplacement;
-
-	//						if (xPos < 0 || zPos < 0 || xPos >= terrainSize || zPos >= terrainSize) continue;
-
-	//						const float distance{ sqrtf(static_cast<float>(xDisplacement * xDisplacement + zDisplacement * zDisplacement)) };
-	//						const int radiusIdx{ radX + radZ * m_ErosionRadius };
-	//						radiusWeights[radiusIdx] = distance;
-
-	//						if (smallestDistance > distance) smallestDistance = distance;
-	//						if (highestDistance < distance) highestDistance = distance;
-	//					}
-	//				}
-
-	//				// Reverse the weights
-	//				for (float& weight : radiusWeights)
-	//				{
-	//					weight = 1.0f - (weight - smallestDistance) / (highestDistance - smallestDistance);
-	//					totalWeight += weight;
-	//				}
-
-	//				// Normalize the weights
-	//				for (float& weight : radiusWeights)
-	//				{
-	//					weight /= totalWeight;
-	//				}
-
-	//				// Remove the sediment from all the grid positions in the radius of the droplet
-	//				for (int radX{}; radX < m_ErosionRadius; ++radX)
-	//				{
-	//					for (int radZ{}; radZ < m_ErosionRadius; ++radZ)
-	//					{
-	//						const int xPos = radX - halfErosionRadius;
-	//						const int zPos = radZ - halfErosionRadius;
-
-	//						if (x + xPos < 0 || z + zPos < 0 || x + xPos >= terrainSize || z + zPos >= terrainSize) continue;
-
-	//						const int radiusIdx{ radX + radZ * m_ErosionRadius };
-	//						*cells[x + xPos + (z + zPos) * terrainSize].height -= removedSediment * radiusWeights[radiusIdx];
-	//					}
-	//				}
-
-	//				cell.sediment += removedSediment;
-	//			}
-	//			else
-	//			{
-	//				const float addedSediment{ m_Deposition * (cell.sediment - curCapacity) };
-
-	//				*cell.height += addedSediment;
-	//				cell.sediment -= addedSediment;
-	//			}
-	//		}
-	//	}
-
-	//	// Move sediment with the water flow and evaporate water
-	//	for (int x{}; x < terrainSize; ++x)
-	//	{
-	//		for (int y{}; y < terrainSize; ++y)
-	//		{
-	//			// Get the current cell
-	//			const int cellIdx{ x + y * terrainSize };
-	//			Cell& cell{ cells[cellIdx] };
-
-	//			// Find the previous cell depending on the velocity (e.g. if moving forward, get the back cell)
-	//			const int incomingSedimentX{ static_cast<int>(x + 0.5f - cell.velocityX * m_TimeStep) };
-	//			const int incomingSedimentY{ static_cast<int>(y + 0.5f - cell.velocityY * m_TimeStep) };
-
-	//			if (abs(cell.velocityX) < 0.5f && abs(cell.velocityY) < 0.5f)
-	//			{
-	//				int test{};
-	//				test;
-	//			}
-
-	//			if (incomingSedimentX < 0 || incomingSedimentX >= terrainSize || incomingSedimentY < 0 || incomingSedimentY >= terrainSize)
-	//			{
-	//				// If the cell doesn't exist, find the four closest neighbouring cells and take the average of their sediment values
-	//				int closestX[4]{};
-	//				int closestY[4]{};
-	//				float closestSediments[4]{};
-	//				int closestDistances[4]{ INT_MAX, INT_MAX, INT_MAX, INT_MAX };
-
-	//				// Find four closest neighbours
-	//				for (int otherX{ -2 }; otherX <= 2; ++otherX)
-	//				{
-	//					if (incomingSedimentX + otherX < 0 || incomingSedimentX + otherX >= terrainSize) continue;
-
-	//					for (int otherY{ -2 }; otherY <= 2; ++otherY)
-	//					{
-	//						if (incomingSedimentY + otherY < 0 || incomingSedimentY + otherY >= terrainSize) continue;
-
-	//						const int distance{ otherX * otherX + otherY * otherY };
-
-	//						for (int neighbourIdx{}; neighbourIdx < 4; ++neighbourIdx)
-	//						{
-	//							int& neighbourDistance{ closestDistances[neighbourIdx] };
-	//							if (neighbourDistance < distance) continue;
-
-	//							neighbourDistance = distance;
-	//							closestX[neighbourIdx] = incomingSedimentX + otherX;
-	//							closestY[neighbourIdx] = incomingSedimentY + otherY;
-	//							const int neighbourCellIdx{ static_cast<int>(incomingSedimentX + otherX) + static_cast<int>(incomingSedimentY + otherY) * terrainSize };
-	//							closestSediments[neighbourIdx] = cells[neighbourCellIdx].sediment;
-	//						}
-	//					}
-	//				}
-
-	//				// Calculate average of their sediment values
-	//				cell.sediment = (closestSediments[0] + closestSediments[1] + closestSediments[2] + closestSediments[3]) / 4.0f;
-	//			}
-	//			else
-	//			{
-	//				// Move the sediment from the previous cell to the next one
-	//				const int incomingSedimentIdx{ incomingSedimentX + incomingSedimentY * terrainSize };
-
-	//				cell.sediment = cells[incomingSedimentIdx].sediment;
-	//			}
-
-	//			// Evaporate water
-	//			cell.water *= (1.0f - m_Evaporation);
-	//		}
-	//	}
-	//}
+	const int stride{ grid.GetStride() };
+	const int firstCellIdx{ grid.GetIndex(x, y) };
+	const float* pSediment{ grid.sediment.data() + firstCellIdx };
+	const float maxTravelDistance{ static_cast<float>(m_MaxTravelDistance) };
+
+	std::array<float, NrCells> sediment{};
+
+	for (int cellIdx{}; cellIdx < NrCells; ++cellIdx)
+	{
+		// Trace the water back along its velocity to find where the sediment in this cell comes from, relative to the current cell
+		//	The halo is as wide as the furthest distance sediment can travel, so the traced position always lies inside the grid
+		//	The clamp changes the physics for water that moves further than that in one time step, its sediment lags behind the water
+		const float traceX{ -std::clamp(grid.velocityX[firstCellIdx + cellIdx] * m_TimeStep, -maxTravelDistance, maxTravelDistance) };
+		const float traceY{ -std::clamp(grid.velocityY[firstCellIdx + cellIdx] * m_TimeStep, -maxTravelDistance, maxTravelDistance) };
+
+		// Find the lower left cell of the four cells around the traced position
+		//	A trace that ends exactly on the furthest cell uses the cell before it with a weight of 1, so no cell outside the halo is ever read
+		const float cellX{ std::clamp(std::floor(traceX), -maxTravelDistance, maxTravelDistance - 1.0f) };
+		const float cellY{ std::clamp(std::floor(traceY), -maxTravelDistance, maxTravelDistance - 1.0f) };
+		const float weightX{ traceX - cellX };
+		const float weightY{ traceY - cellY };
+
+		// Interpolate the sediment of the four cells, the halo never holds sediment so nothing flows in from outside the chunk
+		const int sampleIdx{ cellIdx + static_cast<int>(cellX) + static_cast<int>(cellY) * stride };
+		const float bottomSediment{ (1.0f - weightX) * pSediment[sampleIdx] + weightX * pSediment[sampleIdx + 1] };
+		const float topSediment{ (1.0f - weightX) * pSediment[sampleIdx + stride] + weightX * pSediment[sampleIdx + stride + 1] };
+		sediment[cellIdx] = (1.0f - weightY) * bottomSediment + weightY * topSediment;
+	}
+
+	float* pTerrain{ grid.terrain.GetData() + firstCellIdx };
+	for (int cellIdx{}; cellIdx < NrCells; ++cellIdx)
+	{
+		// Evaporate water
+		const float water{ grid.water[firstCellIdx + cellIdx] * (1.0f - m_Evaporation) };
+
+		// Water that is too shallow dries up, it drops its sediment and stops flowing
+		//	A cell without water then stays the same until water reaches it again
+		const float wetMask{ water >= m_MinWaterHeight ? 1.0f : 0.0f };
+		grid.water[firstCellIdx + cellIdx] = water * wetMask;
+		grid.nextSediment[firstCellIdx + cellIdx] = sediment[cellIdx] * wetMask;
+		pTerrain[cellIdx] += sediment[cellIdx] * (1.0f - wetMask);
+		grid.fluxLeft[firstCellIdx + cellIdx] *= wetMask;
+		grid.fluxRight[firstCellIdx + cellIdx] *= wetMask;
+		grid.fluxTop[firstCellIdx + cellIdx] *= wetMask;
+		grid.fluxBottom[firstCellIdx + cellIdx] *= wetMask;
+	}
 }
 
 void Erosion::VelocityField::OnGUI()
@@ -313,7 +497,15 @@ void Erosion::VelocityField::OnGUI()
 	ImGui::SliderFloat("Erosion", &m_Erosion, 0.0f, 1.0f);
 	ImGui::SliderFloat("Deposition", &m_Deposition, 0.0f, 1.0f);
 	ImGui::SliderFloat("Evaporation", &m_Evaporation, 0.0f, 1.0f);
-	ImGui::SliderFloat("Time step", &m_TimeStep, 0.0f, 5.0f);
+	ImGui::SliderFloat("Min water height", &m_MinWaterHeight, 0.0f, 0.001f, "%0.10f");
+	// A larger time step would move most of the sediment further than the halo allows, so it would only be clamped
+	ImGui::SliderFloat("Time step", &m_TimeStep, 0.0f, static_cast<float>(m_MaxTravelDistance));
 	ImGui::SliderFloat("Pipe length", &m_PipeLength, 0.0f, 5.0f);
 	ImGui::SliderFloat("Pipe area", &m_PipeArea, 0.0f, 5.0f);
+	ImGui::Checkbox("Use temporal blocking", &m_UseTemporalBlocking);
+	if (m_UseTemporalBlocking)
+	{
+		ImGui::SliderInt("Cycles per block", &m_StepsPerBlock, 1, 16);
+		ImGui::SliderInt("Block size", &m_BlockSize, 16, 256);
+	}
 }
@@ -1,32 +1,150 @@
 #pragma once
 
 #include "ITerrainGenerator.h"
+#include "../Data/HeightTile.h"
+#include "../Data/CounterRandom.h"
+
+#include <vector>
+#include <cstdint>
 
 namespace Erosion
 {
+	// A virtual pipe model, water flows between neighbouring cells through pipes and carries sediment with its velocity
 	class VelocityField final : public ITerrainGenerator
 	{
 	public:
-		struct Cell final
-		{
-			float* height{};
-			float water{};
-			float leftFlux{};
-			float rightFlux{};
-			float topFlux{};
-			float bottomFlux{};
-			float velocityX{};
-			float velocityY{};
-			float sediment{};
-			float incomingSediment{};
-		};
-
 		virtual ~VelocityField() = default;
 
+		virtual void SetChunk(int x, int y) override { m_ChunkX = x; m_ChunkY = y; }
 		virtual void GetHeights(Heightmap& heights) override;
 		virtual void OnGUI() override;
 
 	private:
+		// A rectangle of cells in grid coordinates, the end is not part of the area
+		struct Area final
+		{
+			int firstX{};
+			int firstY{};
+			int endX{};
+			int endY{};
+		};
+
+		// The state of the pipes over a rectangle of the grid, the grid is the chunk with a halo around it
+		//	Every quantity has its own buffer, so a pass only streams the buffers it needs
+		//	The halo holds the terrain of the neighbouring chunks but never holds water, water that flows into the halo leaves the chunk
+		struct PipeGrid final
+		{
+			explicit PipeGrid(const Area& area)
+				: terrain{ area.firstX, area.firstY, area.endX - area.firstX, area.endY - area.firstY }
+				, nextTerrain{ terrain }
+				, water(terrain.GetSizeX() * terrain.GetSizeY())
+				, fluxLeft(water.size())
+				, fluxRight(water.size())
+				, fluxTop(water.size())
+				, fluxBottom(water.size())
+				, velocityX(water.size())
+				, velocityY(water.size())
+				, sediment(water.size())
+				, nextSediment(water.size())
+			{
+			}
+
+			// Returns the index of the grid coordinate (x,y) inside the buffers
+			int GetIndex(int x, int y) const { return terrain.GetIndex(x, y); }
+			int GetStride() const { return terrain.GetSizeX(); }
+
+			// The terrain and sediment are read by the neighbours of a cell while they change, so they are written to a second buffer and swapped after the pass
+			HeightTile terrain;
+			HeightTile nextTerrain;
+
+			std::vector<float> water{};
+			std::vector<float> fluxLeft{};
+			std::vector<float> fluxRight{};
+			std::vector<float> fluxTop{};
+			std::vector<float> fluxBottom{};
+			std::vector<float> velocityX{};
+			std::vector<float> velocityY{};
+			std::vector<float> sediment{};
+			std::vector<float> nextSediment{};
+		};
+
+		// The blocks of the chunk that hold water, every block is as high as a band of rows
+		//	Cells without water don't change, so only the blocks with water and the blocks next to them need to be simulated
+		struct ActiveBlocks final
+		{
+			ActiveBlocks(int blocksX, int blocksY)
+				: nrBlocksX{ blocksX }
+				, nrBlocksY{ blocksY }
+				, isActive(blocksX * blocksY)
+				, isVisited(blocksX * blocksY)
+				, wasVisited(blocksX * blocksY)
+			{
+			}
+
+			int nrBlocksX{};
+			int nrBlocksY{};
+
+			// A byte per block, so the threads of different bands can write their own blocks
+			std::vector<uint8_t> isActive{};
+			std::vector<uint8_t> isVisited{};
+			std::vector<uint8_t> wasVisited{};
+		};
+
+		// Advances every cell of the area of the grid by one cycle
+		//	Only the cells within margin cells of the area are up to date at the start, every pass after that is correct for a smaller rectangle
+		//	With active blocks the passes only visit the blocks around water and divide the bands of rows over the threads, otherwise the calling thread handles the whole area
+		void Simulate(PipeGrid& grid, const Area& area, int margin, const Area& chunkArea, const CounterRandom& random, int cycleIdx, ActiveBlocks* pActiveBlocks) const;
+		// Simulates several cycles of the grid block by block, so a block stays in the cache for all of its cycles
+		//	A block copies its part of the grid with a margin of m_StepRadius cells per cycle, so it never needs cells of the other blocks in between cycles
+		void SimulateBlocks(PipeGrid& grid, const std::vector<Area>& blocks, std::vector<PipeGrid>& blockGrids, const Area& chunkArea, const CounterRandom& random, int firstCycleIdx, int nrCycles) const;
+
+		void AddWater(PipeGrid& grid, const Area& area, const Area& chunkArea, const CounterRandom& random, int cycleIdx, ActiveBlocks* pActiveBlocks) const;
+		void CalculateFlux(PipeGrid& grid, const Area& area, const ActiveBlocks* pActiveBlocks) const;
+		void CalculateVelocity(PipeGrid& grid, const Area& area, const ActiveBlocks* pActiveBlocks) const;
+		void TransportSediment(PipeGrid& grid, const Area& area, const ActiveBlocks* pActiveBlocks) const;
+		// Marks the blocks that will be visited this cycle, the blocks with water and every block next to them
+		//	Blocks that stop being visited get the same values in both buffers of the terrain and sediment, so swapping the buffers doesn't change them
+		void UpdateVisitedBlocks(PipeGrid& grid, const Area& area, ActiveBlocks& activeBlocks) const;
+		// Marks the visited blocks that still hold water after the cycle
+		void UpdateActiveBlocks(const PipeGrid& grid, const Area& area, ActiveBlocks& activeBlocks) const;
+		void SettleSediment(PipeGrid& grid, const Area& area) const;
+
+		// Copies the state of the cycles of the area from one grid to another, both grids must contain the area
+		static void CopyState(const PipeGrid& source, PipeGrid& destination, const Area& area);
+		// Returns the area grown by an amount of cells on every side, but never outside the limits
+		static Area Grow(const Area& area, int nrCells, const Area& limits);
+
+		// Calls the function with a row and the first and end column of every part of a row that needs to be visited
+		//	With active blocks these are the rows of the visited blocks and the bands are divided over the threads
+		//	Every pass only writes to the cells of its own row, so the bands never wait for each other
+		template<typename Function>
+		void ForEachSpan(const Area& area, const ActiveBlocks* pActiveBlocks, const Function& function) const;
+		// Calls the function with the first and end cell of every visited block, the bands of blocks are divided over the threads
+		template<typename Function>
+		void ForEachVisitedBlock(const Area& area, const ActiveBlocks& activeBlocks, const Function& function) const;
+
+		// The kernels of the passes handle NrCells neighbouring cells of a row at once, starting at cell (x,y)
+		//	They first calculate every cell into local arrays and only then write the results, so the compiler can keep the whole group in vector registers
+		template<int NrCells>
+		void CalculateFlux(PipeGrid& grid, int x, int y) const;
+		template<int NrCells>
+		void CalculateVelocity(PipeGrid& grid, int x, int y) const;
+		template<int NrCells>
+		void TransportSediment(PipeGrid& grid, int x, int y) const;
+
+		// The furthest distance in cells that sediment can travel in a single cycle, the GUI limits the time step to it as well
+		//	So water of up to one cell per time unit is traced exactly, faster water only carries its sediment this far, which changes the physics: the sediment lags behind the water
+		static constexpr int m_MaxTravelDistance{ 1 };
+		// The amount of cells around the chunk that are copied from the neighbouring chunks, the sediment of a cell can always be traced back inside the grid
+		static constexpr int m_HaloSize{ m_MaxTravelDistance };
+		// The distance over which a cell influences other cells in a single cycle
+		//	Water moves one cell in the flux pass and one more in the velocity pass, sediment moves again during transport
+		static constexpr int m_StepRadius{ 2 + m_MaxTravelDistance };
+		// The amount of cells that are calculated together, 8 floats fill an AVX register
+		static constexpr int m_VectorWidth{ 8 };
+		// The width and height of the blocks that are skipped without water, which is also the amount of rows that a thread handles at once
+		static constexpr int m_BandHeight{ 8 };
+
 		int m_Cycles{ 248 };
 		int m_DropletsPerCycle{ 100 };
 		float m_WaterIncrement{ 0.0316f };
@@ -38,7 +156,17 @@ namespace Erosion
 		float m_Deposition{ 0.0f };
 		float m_Evaporation{ 0.090f };
 		float m_FluxEpsilon{ 0.000001f };
+		// Water that is less deep than this dries up, so cells without water can be skipped
+		float m_MinWaterHeight{ 0.00001f };
 		float m_TimeStep{ 1.0f };
-		int m_ErosionRadius{ 5 };
+
+		// Temporal blocking data
+		bool m_UseTemporalBlocking{};
+		int m_StepsPerBlock{ 4 };
+		int m_BlockSize{ 64 };
+
+		// Chunk data
+		int m_ChunkX{};
+		int m_ChunkY{};
 	};
-}
\ No newline at end of file
+}
@@ -5,6 +5,9 @@
 #include <Presets/Presets.h>
 
 #include "../ErosionAlgorithms/HansBeyer.h"
+#include "../ErosionAlgorithms/ThermalErosion.h"
+#include "../ErosionAlgorithms/Smoothing.h"
+#include "../ErosionAlgorithms/ErosionChain.h"
 
 #include <algorithm>
 
@@ -16,7 +19,16 @@ Erosion::TerrainManager::TerrainManager()
 	{
 		[this]()
 		{
-			std::unique_ptr<ITerrainGenerator> pErosion = std::make_unique<HansBeyer>();
+			// The droplets carve the chunk, thermal erosion flattens the spikes they leave behind once the chunk is finished
+			auto pDroplets{ std::make_unique<HansBeyer>() };
+			HansBeyer::Settings dropletSettings{ pDroplets->GetSettings() };
+			dropletSettings.cycles = m_DropletsPerChunk;
+			pDroplets->SetSettings(dropletSettings);
+
+			auto pChain{ std::make_unique<ErosionChain>(std::move(pDroplets)) };
+			pChain->AddStage(std::make_unique<ThermalErosion>());
+			if constexpr (m_SmoothErodedChunks) pChain->AddStage(std::make_unique<Smoothing>());
+			std::unique_ptr<ITerrainGenerator> pErosion{ std::move(pChain) };
 			while (true)
 			{
 				if (!m_Running) return;
@@ -26,62 +38,17 @@ Erosion::TerrainManager::TerrainManager()
 				if (m_ChunkQueue.empty())
 				{
 					m_QueueMutex.unlock();
+
+					// Only erode when nothing else is requested, so new chunks never wait for a whole chunk to be eroded
+					EvictDistantChunks();
+					ContinueErosion(pErosion);
 					continue;
 				}
 				Chunk chunk{ m_ChunkQueue.front() };
 				m_ChunkQueue.pop();
 				m_QueueMutex.unlock();
 
-				const bool exists{ m_ActiveChunks.contains(chunk.x) && m_ActiveChunks[chunk.x].contains(chunk.y) && m_ActiveChunks[chunk.x][chunk.y].first };
-
-				if (!chunk.eroded && exists) continue;
-
-				bool isChunkEroded{ m_ErodedChunks.contains(chunk.x) && m_ErodedChunks[chunk.x].contains(chunk.y) };
-				if (chunk.eroded && !isChunkEroded)
-				{
-					m_ErodedChunks[chunk.x].insert(chunk.y);
-					Erode(chunk.x, chunk.y, pErosion);
-				}
-
-				// Generate perlin for non eroded chunks
-				if (!chunk.eroded && !isChunkEroded)
-				{
-					const int paddingSize{ m_ChunkSize / 2 };
-					for (int x{}; x < m_ChunkSize; ++x)
-					{
-						for (int y{}; y < m_ChunkSize; ++y)
-						{
-							m_Heightmap.GetHeight(paddingSize + chunk.x * (m_ChunkSize - 1) + x, paddingSize + chunk.y * (m_ChunkSize - 1) + y);
-						}
-					}
-				}
-
-				m_ActiveChunks[chunk.x][chunk.y] = std::make_pair(chunk.pTerrain, isChunkEroded);
-
-				if ((chunk.eroded && isChunkEroded) || !chunk.eroded)
-				{
-					m_ChangedChunks.emplace_back(chunk.x, chunk.y, m_ActiveChunks[chunk.x][chunk.y].first);
-				}
-				else
-				{
-					for (int x{ -1 }; x <= 1; ++x)
-					{
-						for (int y{ -1 }; y <= 1; ++y)
-						{
-							if (!m_ActiveChunks.contains(chunk.x + x)) continue;
-							if (!m_ActiveChunks[chunk.x].contains(chunk.y + y)) continue;
-
-							auto pTerrain{ m_ActiveChunks[chunk.x + x][chunk.y + y].first };
-
-							if (pTerrain == nullptr) continue;
-
-							m_ChangedChunks.emplace_back(chunk.x + x, chunk.y + y, m_ActiveChunks[chunk.x + x][chunk.y + y].first);
-						}
-					}
-				}
-
-				m_Reload = true;
-				m_MainThreadBusy = true;
+				ProcessChunk(chunk);
 			}
 		}
 	};
@@ -109,6 +76,13 @@ void Erosion::TerrainManager::Unregister(int x, int y)
 	m_ActiveChunks[x].erase(y);
 }
 
+void Erosion::TerrainManager::SetErosionArea(int centerX, int centerY, int range)
+{
+	m_ErosionCenterX = centerX;
+	m_ErosionCenterY = centerY;
+	m_ErosionRange = range;
+}
+
 void Erosion::TerrainManager::Update()
 {
 	if (!m_Reload) return;
@@ -133,10 +107,131 @@ void Erosion::TerrainManager::Update()
 	m_MainThreadBusy = false;
 }
 
-void Erosion::TerrainManager::Erode(int x, int y, const std::unique_ptr<ITerrainGenerator>& pErosion)
+void Erosion::TerrainManager::ProcessChunk(const Chunk& chunk)
+{
+	const bool exists{ m_ActiveChunks.contains(chunk.x) && m_ActiveChunks[chunk.x].contains(chunk.y) && m_ActiveChunks[chunk.x][chunk.y].first };
+
+	if (!chunk.eroded && exists) return;
+
+	const bool isChunkEroded{ m_ErodedChunks.contains(chunk.x) && m_ErodedChunks[chunk.x].contains(chunk.y) };
+	if (chunk.eroded && !isChunkEroded)
+	{
+		m_ActiveChunks[chunk.x][chunk.y] = std::make_pair(chunk.pTerrain, false);
+
+		// Start a new job, unless the chunk already has a job that was paused when it left the erosion area
+		const bool hasJob{ std::any_of(begin(m_ErosionJobs), end(m_ErosionJobs), [&chunk](const ErosionJob& job) { return job.chunkX == chunk.x && job.chunkY == chunk.y; }) };
+		if (!hasJob) m_ErosionJobs.push_back(ErosionJob{ chunk.x, chunk.y });
+
+		// A new chunk shows its current heights until the erosion is finished
+		if (exists) return;
+	}
+	else
+	{
+		// Generate perlin for non eroded chunks
+		if (!chunk.eroded && !isChunkEroded)
+		{
+			const int paddingSize{ m_ChunkSize / 2 };
+			for (int x{}; x < m_ChunkSize; ++x)
+			{
+				for (int y{}; y < m_ChunkSize; ++y)
+				{
+					m_Heightmap.GetHeight(paddingSize + chunk.x * (m_ChunkSize - 1) + x, paddingSize + chunk.y * (m_ChunkSize - 1) + y);
+				}
+			}
+		}
+
+		m_ActiveChunks[chunk.x][chunk.y] = std::make_pair(chunk.pTerrain, isChunkEroded);
+	}
+
+	m_ChangedChunks.emplace_back(chunk.x, chunk.y, m_ActiveChunks[chunk.x][chunk.y].first);
+
+	m_Reload = true;
+	m_MainThreadBusy = true;
+}
+
+void Erosion::TerrainManager::ContinueErosion(const std::unique_ptr<ITerrainGenerator>& pErosion)
+{
+	// Pick the jobs closest to the center of the erosion area, jobs outside the area stay paused
+	std::vector<ErosionJob*> pJobs{};
+	for (ErosionJob& job : m_ErosionJobs)
+	{
+		if (IsInErosionArea(job.chunkX, job.chunkY)) pJobs.push_back(&job);
+	}
+
+	if (pJobs.empty()) return;
+
+	const auto getDistance{ [this](const ErosionJob* pJob) { return std::max(abs(pJob->chunkX - m_ErosionCenterX), abs(pJob->chunkY - m_ErosionCenterY)); } };
+	const size_t nrJobs{ std::min(pJobs.size(), static_cast<size_t>(m_MaxParallelJobs)) };
+	std::partial_sort(begin(pJobs), begin(pJobs) + nrJobs, end(pJobs), [&getDistance](const ErosionJob* pJobA, const ErosionJob* pJobB) { return getDistance(pJobA) < getDistance(pJobB); });
+	pJobs.resize(nrJobs);
+
+	// Erode a single slice of every job at the same time, the jobs keep their progress so they can continue where they stopped
+	pErosion->ResumeParallel(m_Heightmap, pJobs, m_DropletsPerSlice);
+
+	// Several jobs can finish in the same slice, the main thread reads the changed chunks as soon as the reload is requested
+	//	So every finished job is recorded first and the reload is only requested once all of them are recorded
+	bool hasFinishedJobs{};
+	for (const ErosionJob* pJob : pJobs)
+	{
+		if (!pJob->isFinished) continue;
+
+		FinishErosion(*pJob);
+		hasFinishedJobs = true;
+	}
+
+	std::erase_if(m_ErosionJobs, [](const ErosionJob& job) { return job.isFinished; });
+
+	if (!hasFinishedJobs) return;
+
+	m_Reload = true;
+	m_MainThreadBusy = true;
+}
+
+void Erosion::TerrainManager::FinishErosion(const ErosionJob& job)
+{
+	m_ErodedChunks[job.chunkX].insert(job.chunkY);
+
+	// Erosion changes the edges of the neighbouring chunks as well
+	for (int x{ -1 }; x <= 1; ++x)
+	{
+		for (int y{ -1 }; y <= 1; ++y)
+		{
+			if (!m_ActiveChunks.contains(job.chunkX + x)) continue;
+			if (!m_ActiveChunks[job.chunkX + x].contains(job.chunkY + y)) continue;
+
+			auto pTerrain{ m_ActiveChunks[job.chunkX + x][job.chunkY + y].first };
+
+			if (pTerrain == nullptr) continue;
+
+			m_ChangedChunks.emplace_back(job.chunkX + x, job.chunkY + y, pTerrain);
+		}
+	}
+}
+
+void Erosion::TerrainManager::EvictDistantChunks()
+{
+	const int centerX{ m_ErosionCenterX };
+	const int centerY{ m_ErosionCenterY };
+
+	if (centerX == m_EvictionCenterX && centerY == m_EvictionCenterY) return;
+
+	m_EvictionCenterX = centerX;
+	m_EvictionCenterY = centerY;
+
+	// Keep every height of the chunks around the player in memory
+	const int paddingSize{ m_ChunkSize / 2 };
+	const int minX{ paddingSize + (centerX - m_CachedChunkRange) * (m_ChunkSize - 1) };
+	const int minY{ paddingSize + (centerY - m_CachedChunkRange) * (m_ChunkSize - 1) };
+	const int maxX{ paddingSize + (centerX + m_CachedChunkRange + 1) * (m_ChunkSize - 1) };
+	const int maxY{ paddingSize + (centerY + m_CachedChunkRange + 1) * (m_ChunkSize - 1) };
+
+	m_Heightmap.EvictChunksOutside(minX, minY, maxX, maxY);
+}
+
+bool Erosion::TerrainManager::IsInErosionArea(int x, int y) const
 {
-	pErosion->SetChunk(x, y);
-	pErosion->GetHeights(m_Heightmap);
+	const int range{ m_ErosionRange };
+	return abs(x - m_ErosionCenterX) < range && abs(y - m_ErosionCenterY) < range;
 }
 
 void Erosion::TerrainManager::UpdateComponents(int /*chunkX*/, int /*chunkY*/)
@@ -8,6 +8,8 @@
 #include <mutex>
 #include <memory>
 #include <set>
+#include <atomic>
+#include <climits>
 
 #include "../ErosionAlgorithms/ITerrainGenerator.h"
 #include <Generator.h>
@@ -34,6 +36,7 @@ namespace Erosion
 
 		void Generate(int x, int y, leap::TerrainComponent* pTerrain, bool eroded);
 		void Unregister(int x, int y);
+		void SetErosionArea(int centerX, int centerY, int range);
 		void Update();
 		Heightmap& GetHeightmap() { return m_Heightmap; }
 
@@ -46,13 +49,27 @@ namespace Erosion
 			bool eroded{};
 		};
 
-		void Erode(int x, int y, const std::unique_ptr<ITerrainGenerator>& pErosion);
+		void ProcessChunk(const Chunk& chunk);
+		void ContinueErosion(const std::unique_ptr<ITerrainGenerator>& pErosion);
+		void FinishErosion(const ErosionJob& job);
+		void EvictDistantChunks();
+		bool IsInErosionArea(int x, int y) const;
 		void UpdateComponents(int x, int y);
 
 		std::mutex m_QueueMutex{};
 		std::queue<Chunk> m_ChunkQueue{};
 
 		static const int m_ChunkSize{ 257 };
+		// The amount of droplets that is simulated before the queue is checked again
+		static const int m_DropletsPerSlice{ 5'000 };
+		// The amount of jobs that are eroded at the same time, this doesn't depend on the amount of threads so the result is always the same
+		static const int m_MaxParallelJobs{ 8 };
+		// The amount of droplets per chunk, thermal erosion smooths the chunk afterwards so fewer droplets give the same spread of slopes
+		static const int m_DropletsPerChunk{ 50'000 };
+		// Adds a smoothing stage after thermal erosion, the thermal stage already removes the spikes so the chunks are only smoothed on request
+		static const bool m_SmoothErodedChunks{ false };
+		// Chunks further than this amount of chunks from the player are only kept as their changes compared to the noise
+		static const int m_CachedChunkRange{ 12 };
 
 		Heightmap m_Heightmap{ m_ChunkSize };
 		int m_HeightmapSize{};
@@ -60,6 +77,14 @@ namespace Erosion
 		std::map<int, std::map<int, std::pair<leap::TerrainComponent*, bool>>> m_ActiveChunks{};
 		std::vector<Chunk> m_ChangedChunks{};
 
+		// Erosion jobs outside the erosion area are paused, they are resumed when their chunk gets close again
+		std::vector<ErosionJob> m_ErosionJobs{};
+		std::atomic<int> m_ErosionCenterX{};
+		std::atomic<int> m_ErosionCenterY{};
+		std::atomic<int> m_ErosionRange{ INT_MAX };
+		int m_EvictionCenterX{};
+		int m_EvictionCenterY{};
+
 		bool m_Running{ true };
 		bool m_Reload{};
 		bool m_MainThreadBusy{};
@@ -0,0 +1,274 @@
+#include "ErosionSweep.h"
+#include "../ErosionAlgorithms/ErosionChain.h"
+
+#include <execution>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <stdexcept>
+#include <cmath>
+
+const int Erosion::ErosionSweep::m_ChunkSize{ 257 };
+const int Erosion::ErosionSweep::m_FirstChunk{ 2 };
+const int Erosion::ErosionSweep::m_NrChunks{ 2 };
+const int Erosion::ErosionSweep::m_ChannelThreshold{ 100 };
+const float Erosion::ErosionSweep::m_SlopeBinSize{ 0.00025f };
+
+Erosion::ErosionSweep::ErosionSweep(const std::vector<Parameter>& parameters, unsigned int worldSeed)
+	: m_Parameters{ parameters }
+	, m_WorldSeed{ worldSeed }
+{
+	for (const Parameter& parameter : m_Parameters)
+	{
+		if (parameter.values.empty()) throw std::runtime_error("ErosionSweep: parameter " + parameter.name + " has no values");
+
+		// Check the name of the parameter before any erosion starts
+		Variation variation{};
+		SetParameter(variation, parameter.name, parameter.values.front());
+	}
+}
+
+std::vector<Erosion::ErosionSweep::Variation> Erosion::ErosionSweep::CreateGrid() const
+{
+	std::vector<Variation> variations{ CreateDefaultVariation() };
+
+	// Every parameter multiplies the variations that were created so far by its amount of values
+	for (const Parameter& parameter : m_Parameters)
+	{
+		std::vector<Variation> newVariations{};
+		newVariations.reserve(variations.size() * parameter.values.size());
+
+		for (const Variation& variation : variations)
+		{
+			for (float value : parameter.values)
+			{
+				Variation& newVariation{ newVariations.emplace_back(variation) };
+				SetParameter(newVariation, parameter.name, value);
+			}
+		}
+
+		variations = std::move(newVariations);
+	}
+
+	return variations;
+}
+
+std::vector<Erosion::ErosionSweep::Variation> Erosion::ErosionSweep::CreateRandom(int nrVariations, unsigned int seed) const
+{
+	std::mt19937 randomEngine{ seed };
+
+	std::vector<Variation> variations(nrVariations, CreateDefaultVariation());
+	for (Variation& variation : variations)
+	{
+		for (const Parameter& parameter : m_Parameters)
+		{
+			const auto [lowestIt, highestIt] { std::minmax_element(begin(parameter.values), end(parameter.values)) };
+			std::uniform_real_distribution<float> distribution{ *lowestIt, *highestIt };
+
+			SetParameter(variation, parameter.name, distribution(randomEngine));
+		}
+	}
+
+	return variations;
+}
+
+void Erosion::ErosionSweep::Run(const std::vector<Variation>& variations, const std::filesystem::path& outputDirectory) const
+{
+	std::filesystem::create_directories(outputDirectory);
+
+	const int regionSize{ m_NrChunks * (m_ChunkSize - 1) + 1 };
+	const int nrVariations{ static_cast<int>(variations.size()) };
+
+	// Erode a few variations per thread at once so every thread stays busy while heightmaps are being created
+	const int batchSize{ static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)) * 2 };
+
+	std::vector<Metrics> metrics(nrVariations);
+	std::vector<std::unique_ptr<Heightmap>> heightmaps{};
+	std::vector<std::vector<float>> heights{};
+
+	for (int batchStart{}; batchStart < nrVariations; batchStart += batchSize)
+	{
+		const int nrBatchVariations{ std::min(batchSize, nrVariations - batchStart) };
+
+		// Create the heightmaps of this batch in order, creating a heightmap changes the global random state
+		heightmaps.clear();
+		for (int i{}; i < nrBatchVariations; ++i)
+		{
+			heightmaps.push_back(std::make_unique<Heightmap>(m_ChunkSize, m_WorldSeed));
+		}
+
+		// Erode every variation of the batch in parallel, each variation has its own heightmap
+		heights.assign(nrBatchVariations, {});
+		std::vector<int> batchIndices(nrBatchVariations);
+		std::iota(begin(batchIndices), end(batchIndices), 0);
+		std::for_each(std::execution::par, begin(batchIndices), end(batchIndices), [&](int batchIdx)
+			{
+				metrics[batchStart + batchIdx] = Erode(*heightmaps[batchIdx], variations[batchStart + batchIdx], heights[batchIdx]);
+			});
+
+		for (int batchIdx{}; batchIdx < nrBatchVariations; ++batchIdx)
+		{
+			WriteHeights(heights[batchIdx], regionSize, outputDirectory / ("variation_" + std::to_string(batchStart + batchIdx) + ".pgm"));
+		}
+	}
+
+	// Write the settings and metrics of every variation as a table
+	std::ofstream table{ outputDirectory / "sweep.csv" };
+	if (!table) throw std::runtime_error("ErosionSweep: can't create " + (outputDirectory / "sweep.csv").string());
+
+	table << "variation,cycles,erosionRadius,maxPathLength,inertia,minSlope,capacity,gravity,evaporation,deposition,erosion,thermalIterations,thermalTalusHeight,thermalStrength,runtimeMs,sedimentMoved,erodedSediment,depositedSediment,lostSediment,meanPathLength,"
+		<< "stoppedBySpeed,stoppedByWater,stoppedByPathLength,stoppedByFlatGradient,leftTile,drainageDensity";
+	for (int binIdx{}; binIdx < m_NrSlopeBins; ++binIdx)
+	{
+		table << ",slope" << binIdx;
+	}
+	table << '\n';
+
+	for (int variationIdx{}; variationIdx < nrVariations; ++variationIdx)
+	{
+		const HansBeyer::Settings& settings{ variations[variationIdx].erosion };
+		const ThermalErosion::Settings& thermalSettings{ variations[variationIdx].thermal };
+		const Metrics& variationMetrics{ metrics[variationIdx] };
+
+		table << variationIdx << ',' << settings.cycles << ',' << settings.erosionRadius << ',' << settings.maxPathLength << ','
+			<< settings.inertia << ',' << settings.minSlope << ',' << settings.capacity << ',' << settings.gravity << ','
+			<< settings.evaporation << ',' << settings.deposition << ',' << settings.erosion << ','
+			<< thermalSettings.iterations << ',' << thermalSettings.talusHeight << ',' << thermalSettings.strength << ','
+			<< variationMetrics.runtime << ',' << variationMetrics.sedimentMoved << ',';
+
+		const ErosionCounters& counters{ variationMetrics.counters };
+		table << counters.erodedSediment << ',' << counters.depositedSediment << ',' << counters.lostSediment << ',' << counters.GetMeanPathLength() << ','
+			<< counters.nrStoppedBySpeed << ',' << counters.nrStoppedByWater << ',' << counters.nrStoppedByPathLength << ','
+			<< counters.nrStoppedByFlatGradient << ',' << counters.nrLeftTile << ',' << variationMetrics.drainageDensity;
+		for (float binFraction : variationMetrics.slopeHistogram)
+		{
+			table << ',' << binFraction;
+		}
+		table << '\n';
+	}
+}
+
+Erosion::ErosionSweep::Metrics Erosion::ErosionSweep::Erode(Heightmap& heightmap, const Variation& variation, std::vector<float>& heights) const
+{
+	// The chain owns its stages, the droplet stage is kept to read its counters
+	auto pErosion{ std::make_unique<HansBeyer>() };
+	pErosion->SetSettings(variation.erosion);
+	const HansBeyer* pDroplets{ pErosion.get() };
+
+	auto pThermalErosion{ std::make_unique<ThermalErosion>() };
+	pThermalErosion->SetSettings(variation.thermal);
+
+	ErosionChain chain{ std::move(pErosion) };
+	chain.AddStage(std::move(pThermalErosion));
+
+	Metrics metrics{};
+
+	// Erode the chunks one after another, like the terrain manager does
+	const auto startTime{ std::chrono::high_resolution_clock::now() };
+	for (int chunkY{ m_FirstChunk }; chunkY < m_FirstChunk + m_NrChunks; ++chunkY)
+	{
+		for (int chunkX{ m_FirstChunk }; chunkX < m_FirstChunk + m_NrChunks; ++chunkX)
+		{
+			chain.SetChunk(chunkX, chunkY);
+			chain.GetHeights(heightmap);
+			metrics.sedimentMoved += chain.GetStatistics().heightChange;
+		}
+	}
+	const auto endTime{ std::chrono::high_resolution_clock::now() };
+	metrics.runtime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	metrics.counters = pDroplets->GetTotalCounters();
+
+	// Read the heights of all the eroded chunks
+	const int regionOrigin{ m_ChunkSize / 2 + m_FirstChunk * (m_ChunkSize - 1) };
+	const int regionSize{ m_NrChunks * (m_ChunkSize - 1) + 1 };
+	heights.resize(regionSize * regionSize);
+	heightmap.ReadRegion(regionOrigin, regionOrigin, regionSize, regionSize, heights.data());
+
+	// The region has no halo, so the metrics only depend on the eroded chunks
+	metrics.drainageDensity = CalculateDrainageDensity(FlowMap::CalculateRegion(heightmap, m_FirstChunk, m_FirstChunk, m_NrChunks, m_NrChunks, 0));
+	metrics.slopeHistogram = CalculateSlopeHistogram(heights, regionSize);
+
+	return metrics;
+}
+
+float Erosion::ErosionSweep::CalculateDrainageDensity(const FlowMap& flow)
+{
+	// The drainage density is the part of the terrain that is covered by channels
+	const std::vector<int>& accumulations{ flow.GetAccumulations() };
+	const auto nrChannelCells{ std::count_if(begin(accumulations), end(accumulations), [](int accumulation) { return accumulation >= m_ChannelThreshold; }) };
+	return static_cast<float>(nrChannelCells) / static_cast<float>(accumulations.size());
+}
+
+std::array<float, Erosion::ErosionSweep::m_NrSlopeBins> Erosion::ErosionSweep::CalculateSlopeHistogram(const std::vector<float>& heights, int size)
+{
+	std::array<float, m_NrSlopeBins> histogram{};
+	if (size < 3) return histogram;
+
+	// Count the slopes of every cell that has a neighbour on each side, the last bin holds every steeper slope
+	for (int y{ 1 }; y < size - 1; ++y)
+	{
+		for (int x{ 1 }; x < size - 1; ++x)
+		{
+			const float gradientX{ (heights[x + 1 + y * size] - heights[x - 1 + y * size]) * 0.5f };
+			const float gradientY{ (heights[x + (y + 1) * size] - heights[x + (y - 1) * size]) * 0.5f };
+			const float slope{ sqrtf(gradientX * gradientX + gradientY * gradientY) };
+
+			const int binIdx{ std::min(static_cast<int>(slope / m_SlopeBinSize), m_NrSlopeBins - 1) };
+			++histogram[binIdx];
+		}
+	}
+
+	// Turn the counts into the part of the terrain inside each bin
+	const float nrCells{ static_cast<float>((size - 2) * (size - 2)) };
+	for (float& binFraction : histogram)
+	{
+		binFraction /= nrCells;
+	}
+
+	return histogram;
+}
+
+void Erosion::ErosionSweep::WriteHeights(const std::vector<float>& heights, int size, const std::filesystem::path& path)
+{
+	std::ofstream file{ path, std::ios::binary };
+	if (!file) throw std::runtime_error("ErosionSweep: can't create " + path.string());
+
+	// A 16-bit grayscale PGM, the values are stored with the most significant byte first
+	file << "P5\n" << size << ' ' << size << "\n65535\n";
+	for (float height : heights)
+	{
+		const int value{ static_cast<int>(std::clamp(height, 0.0f, 1.0f) * 65535.0f + 0.5f) };
+		file.put(static_cast<char>(value >> 8));
+		file.put(static_cast<char>(value & 0xFF));
+	}
+}
+
+Erosion::ErosionSweep::Variation Erosion::ErosionSweep::CreateDefaultVariation()
+{
+	return Variation{ HansBeyer{}.GetSettings(), ThermalErosion{}.GetSettings() };
+}
+
+void Erosion::ErosionSweep::SetParameter(Variation& variation, const std::string& name, float value)
+{
+	HansBeyer::Settings& settings{ variation.erosion };
+	ThermalErosion::Settings& thermalSettings{ variation.thermal };
+
+	if (name == "cycles") settings.cycles = static_cast<int>(std::lround(value));
+	else if (name == "erosionRadius") settings.erosionRadius = static_cast<int>(std::lround(value));
+	else if (name == "maxPathLength") settings.maxPathLength = static_cast<int>(std::lround(value));
+	else if (name == "inertia") settings.inertia = value;
+	else if (name == "minSlope") settings.minSlope = value;
+	else if (name == "capacity") settings.capacity = value;
+	else if (name == "gravity") settings.gravity = value;
+	else if (name == "evaporation") settings.evaporation = value;
+	else if (name == "deposition") settings.deposition = value;
+	else if (name == "erosion") settings.erosion = value;
+	else if (name == "thermalIterations") thermalSettings.iterations = static_cast<int>(std::lround(value));
+	else if (name == "thermalTalusHeight") thermalSettings.talusHeight = value;
+	else if (name == "thermalStrength") thermalSettings.strength = value;
+	else throw std::runtime_error("ErosionSweep: unknown parameter " + name);
+}
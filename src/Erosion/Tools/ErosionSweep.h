@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../ErosionAlgorithms/HansBeyer.h"
+#include "../ErosionAlgorithms/ThermalErosion.h"
+#include "../ErosionAlgorithms/FlowMap.h"
+
+#include <vector>
+#include <array>
+#include <string>
+#include <filesystem>
+
+namespace Erosion
+{
+	// Erodes the same chunks of a seeded world with many different settings of the erosion chain, without opening the viewer
+	//	Every chunk is eroded by HansBeyer followed by thermal erosion, like the terrain manager does, 0 thermal iterations leaves the droplets alone
+	//	Every variation writes its heights to a file and adds a line of metrics to a table, so the variations can be compared afterwards
+	class ErosionSweep final
+	{
+	public:
+		// A parameter of the sweep, named like the members of HansBeyer::Settings or like the members of ThermalErosion::Settings with thermal in front
+		struct Parameter final
+		{
+			std::string name{};
+			std::vector<float> values{};
+		};
+
+		// The settings of every stage of the chain
+		struct Variation final
+		{
+			HansBeyer::Settings erosion{};
+			ThermalErosion::Settings thermal{};
+		};
+
+		static constexpr int m_NrSlopeBins{ 16 };
+
+		struct Metrics final
+		{
+			float runtime{};
+			float sedimentMoved{};
+			float drainageDensity{};
+			std::array<float, m_NrSlopeBins> slopeHistogram{};
+			ErosionCounters counters{};
+		};
+
+		ErosionSweep(const std::vector<Parameter>& parameters, unsigned int worldSeed);
+
+		// Returns every combination of the values of the parameters
+		std::vector<Variation> CreateGrid() const;
+		// Returns settings with every parameter picked at random between its lowest and highest value
+		std::vector<Variation> CreateRandom(int nrVariations, unsigned int seed) const;
+
+		// Erodes the chunks with every variation, writes a heightmap per variation and a table with all the metrics to the output directory
+		void Run(const std::vector<Variation>& variations, const std::filesystem::path& outputDirectory) const;
+
+	private:
+		Metrics Erode(Heightmap& heightmap, const Variation& variation, std::vector<float>& heights) const;
+		static float CalculateDrainageDensity(const FlowMap& flow);
+		static std::array<float, m_NrSlopeBins> CalculateSlopeHistogram(const std::vector<float>& heights, int size);
+		static void WriteHeights(const std::vector<float>& heights, int size, const std::filesystem::path& path);
+		static Variation CreateDefaultVariation();
+		static void SetParameter(Variation& variation, const std::string& name, float value);
+
+		static const int m_ChunkSize;
+		// The square of chunks that is eroded by every variation, large enough for rivers to cross the chunk borders
+		static const int m_FirstChunk;
+		static const int m_NrChunks;
+		// The amount of cells that must drain through a cell before it counts as a channel
+		static const int m_ChannelThreshold;
+		static const float m_SlopeBinSize;
+
+		std::vector<Parameter> m_Parameters{};
+		unsigned int m_WorldSeed{};
+	};
+}
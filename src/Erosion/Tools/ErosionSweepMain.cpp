@@ -0,0 +1,81 @@
+#include "ErosionSweep.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <stdexcept>
+
+namespace
+{
+	// Reads a sweep file, every line holds the name of a parameter followed by its values
+	//	Empty lines and lines that start with # are skipped
+	std::vector<Erosion::ErosionSweep::Parameter> ReadParameters(const std::string& path)
+	{
+		std::ifstream file{ path };
+		if (!file) throw std::runtime_error("Can't open sweep file " + path);
+
+		std::vector<Erosion::ErosionSweep::Parameter> parameters{};
+
+		std::string line{};
+		while (std::getline(file, line))
+		{
+			std::istringstream lineStream{ line };
+
+			Erosion::ErosionSweep::Parameter parameter{};
+			if (!(lineStream >> parameter.name) || parameter.name.front() == '#') continue;
+
+			float value{};
+			while (lineStream >> value)
+			{
+				parameter.values.push_back(value);
+			}
+
+			parameters.push_back(parameter);
+		}
+
+		return parameters;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cout << "Usage: ErosionSweep <sweep file> <output directory> [--random <nr variations>] [--seed <world seed>] [--sampling-seed <seed>]\n";
+		std::cout << "Every line of the sweep file holds a HansBeyer or thermal erosion setting followed by its values, for example: inertia 0.05 0.1 0.2\n";
+		std::cout << "Without --random every combination of the values is eroded, with --random each setting is picked between its lowest and highest value\n";
+		std::cout << "--seed picks the terrain that is eroded, --sampling-seed picks the random settings, so either can change without the other\n";
+		return 1;
+	}
+
+	try
+	{
+		int nrRandomVariations{};
+		unsigned int worldSeed{ 1 };
+		unsigned int samplingSeed{ 1 };
+		for (int argIdx{ 3 }; argIdx < argc; argIdx += 2)
+		{
+			const std::string option{ argv[argIdx] };
+			if (argIdx + 1 >= argc) throw std::runtime_error("Option " + option + " needs a value");
+
+			if (option == "--random") nrRandomVariations = std::stoi(argv[argIdx + 1]);
+			else if (option == "--seed") worldSeed = static_cast<unsigned int>(std::stoul(argv[argIdx + 1]));
+			else if (option == "--sampling-seed") samplingSeed = static_cast<unsigned int>(std::stoul(argv[argIdx + 1]));
+			else throw std::runtime_error("Unknown option " + option);
+		}
+
+		const Erosion::ErosionSweep sweep{ ReadParameters(argv[1]), worldSeed };
+		const auto variations{ nrRandomVariations > 0 ? sweep.CreateRandom(nrRandomVariations, samplingSeed) : sweep.CreateGrid() };
+
+		std::cout << "Eroding " << variations.size() << " variations\n";
+		sweep.Run(variations, argv[2]);
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << exception.what() << '\n';
+		return 1;
+	}
+
+	return 0;
+}